@@ -0,0 +1,64 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file CompiledModel.cpp
+*/
+
+#include "CompiledModel.hpp"
+#include <stdexcept>
+#include <dlfcn.h>
+
+
+namespace minitao {
+
+
+  char const * const compiled_model_factory_name("minitao_create_compiled_model");
+
+
+  CompiledModel * loadCompiledModel(std::string const & library_path)
+  {
+    void * handle(dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL));
+    if ( ! handle) {
+      char const * err(dlerror());
+      throw std::runtime_error("minitao::loadCompiledModel(): dlopen(`" + library_path + "'): "
+			       + std::string(err ? err : "unknown error"));
+    }
+
+    dlerror();
+    compiled_model_factory_t
+      factory(reinterpret_cast<compiled_model_factory_t>(dlsym(handle, compiled_model_factory_name)));
+    char const * err(dlerror());
+    if (err || ( ! factory)) {
+      std::string const msg(err ? err : "NULL symbol");
+      dlclose(handle);
+      throw std::runtime_error("minitao::loadCompiledModel(): dlsym(`"
+			       + std::string(compiled_model_factory_name) + "'): " + msg);
+    }
+
+    return factory();
+  }
+
+}
@@ -0,0 +1,118 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file CompiledModel.hpp
+*/
+
+#ifndef MINITAO_COMPILED_MODEL_HPP
+#define MINITAO_COMPILED_MODEL_HPP
+
+#include <cstddef>
+#include <string>
+
+
+namespace minitao {
+
+
+  /**
+     Common interface to robot-specific model code that was emitted
+     by generateCompiledModel() and then compiled into a shared
+     library. The generated code depends only on this header, it
+     does not link against TAO or Eigen. All matrices are passed as
+     column-major arrays of doubles, so they can be wrapped with
+     e.g. Eigen::Map without copying.
+
+     Nodes are numbered in the order of enumerateNodes(), which is
+     also the order of the degrees of freedom in Model.
+  */
+  class CompiledModel
+  {
+  public:
+    virtual ~CompiledModel() {}
+
+    virtual size_t getNNodes() const = 0;
+    virtual size_t getNDOF() const = 0;
+
+    /** \return The ID of the TAO node at the given index, as used
+	by Model::findNodeByID(). */
+    virtual int getNodeID(size_t index) const = 0;
+
+    /** Store the joint state and compute the forward kinematics
+	for all nodes. Both arrays must have getNDOF() entries. */
+    virtual void setState(double const * position,
+			  double const * velocity) = 0;
+
+    /** Copy the global frame of a node into a 3x3 rotation
+	(column-major) and a 3-element translation. */
+    virtual void getGlobalFrame(size_t index,
+				double * rotation,
+				double * translation) const = 0;
+
+    /** Compute the 6xNDOF Jacobian (column-major, linear part on
+	top) of the point (gx, gy, gz), which is expressed in global
+	coordinates and assumed to be attached to the given node. */
+    virtual void computeJacobian(size_t index,
+				 double gx, double gy, double gz,
+				 double * jacobian) const = 0;
+
+    /** Compute the NDOF gravity torque vector for earth gravity
+	along the negative global Z axis. */
+    virtual void computeGravity(double * gravity) const = 0;
+
+    /** Compute the NDOF Coriolis and centrifugal torque vector for
+	the velocity passed to setState(). */
+    virtual void computeCoriolisCentrifugal(double * coriolis_centrifugal) const = 0;
+
+    /** Compute the NDOFxNDOF mass-inertia matrix. */
+    virtual void computeMassInertia(double * mass_inertia) const = 0;
+
+    /** Compute the NDOFxNDOF inverse of the mass-inertia matrix. */
+    virtual void computeInverseMassInertia(double * inverse_mass_inertia) const = 0;
+  };
+
+
+  /** Signature of the factory function that generated code exports
+      as <code>extern "C"</code> under the name given by
+      compiled_model_factory_name. */
+  typedef CompiledModel * (*compiled_model_factory_t)();
+
+  extern char const * const compiled_model_factory_name;
+
+
+  /**
+     Load a shared library that contains a compiled model and
+     instantiate it. The library stays loaded for the remaining
+     lifetime of the process, the returned object has to be deleted
+     by the caller.
+
+     \note Throws a \c runtime_error if the library cannot be loaded
+     or does not export the factory function.
+  */
+  CompiledModel * loadCompiledModel(std::string const & library_path);
+
+}
+
+#endif // MINITAO_COMPILED_MODEL_HPP
@@ -30,9 +30,16 @@
 
 #include "Model.hpp"
 #include "tao_util.hpp"
+#include "spatial.hpp"
 #include <tao/dynamics/taoNode.h>
 #include <tao/dynamics/taoJoint.h>
 #include <tao/dynamics/taoDynamics.h>
+#include <tao/dynamics/taoABDynamics.h>
+#include <tao/dynamics/taoABNode.h>
+#include <tao/utility/TaoDeMassProp.h>
+#include <Eigen/Cholesky>
+#include <map>
+#include <algorithm>
 
 #undef DEBUG
 
@@ -58,6 +65,216 @@ size_t squareToTriangularIndex(size_t irow, size_t icol, size_t dim)
 }
 
 
+namespace {
+  
+  using minitao::Vector;
+  using minitao::Matrix;
+  using minitao::nodeVector_t;
+  using minitao::global_rotation;
+  using minitao::global_translation;
+  
+  
+  typedef Eigen::Matrix<double, 6, 1> jacobian_column_t;
+  
+  
+  // Global Jacobian column of one DOF of a joint, linear over
+  // angular, taken at the global origin.
+  jacobian_column_t read_jacobian_column(taoJoint * joint, size_t index)
+  {
+    deVector6 Jg_columns[6];	// no joint has more than six DOF
+    joint->getJgColumns(Jg_columns);
+    jacobian_column_t result;
+    for (size_t ii(0); ii < 6; ++ii) {
+      result[ii] = Jg_columns[index].elementAt(ii);
+    }
+    return result;
+  }
+  
+  
+  // Move a column from read_jacobian_column() to a global point and
+  // select the rows given by part.
+  Eigen::VectorXd point_jacobian_column(jacobian_column_t const & origin_column,
+					 Eigen::Vector3d const & global_point,
+					 minitao::SparseJacobian::part_t part)
+  {
+    jacobian_column_t column(origin_column);
+    column.head<3>() += origin_column.tail<3>().cross(global_point);
+    if (minitao::SparseJacobian::POSITION == part) {
+      return column.head<3>();
+    }
+    if (minitao::SparseJacobian::ORIENTATION == part) {
+      return column.tail<3>();
+    }
+    return column;
+  }
+  
+  
+  /**
+     Classical acceleration (linear over angular, global coordinates)
+     of a point attached to a node, given a TAO node acceleration,
+     such as A() or H(). TAO's node accelerations and velocities are
+     classical (not spatial) quantities in node coordinates, taken at
+     the node origin. Moving to another point on the same node adds
+     the tangential and centripetal terms.
+  */
+  Eigen::VectorXd node_point_acceleration(taoDNode * node,
+					   deVector6 const & tao_acc,
+					   Eigen::Vector3d const & global_point)
+  {
+    Eigen::Matrix3d const rotation(global_rotation(node));
+    deVector6 const & tao_vel(*node->getABNode()->V());
+    Eigen::Vector3d const lin(rotation * Eigen::Vector3d(tao_acc[0][0], tao_acc[0][1], tao_acc[0][2]));
+    Eigen::Vector3d const ang(rotation * Eigen::Vector3d(tao_acc[1][0], tao_acc[1][1], tao_acc[1][2]));
+    Eigen::Vector3d const omega(rotation * Eigen::Vector3d(tao_vel[1][0], tao_vel[1][1], tao_vel[1][2]));
+    Eigen::Vector3d const rr(global_point - global_translation(node));
+    Eigen::VectorXd result(6);
+    result.head<3>() = lin + ang.cross(rr) + omega.cross(omega.cross(rr));
+    result.tail<3>() = ang;
+    return result;
+  }
+  
+  
+  /** \return A new joint of the same type and with the same
+      parameters, or NULL if the type is not supported. */
+  taoJoint * clone_joint(taoJoint * joint)
+  {
+    taoJoint * clone(0);
+    if (taoJointRevolute * revolute = dynamic_cast<taoJointRevolute*>(joint)) {
+      clone = new taoJointRevolute(revolute->getAxis());
+      clone->setDVar(new taoVarDOF1);
+    }
+    else if (taoJointPrismatic * prismatic = dynamic_cast<taoJointPrismatic*>(joint)) {
+      clone = new taoJointPrismatic(prismatic->getAxis());
+      clone->setDVar(new taoVarDOF1);
+    }
+    else if (dynamic_cast<taoJointSpherical*>(joint)) {
+      clone = new taoJointSpherical();
+      clone->setDVar(new taoVarSpherical);
+    }
+    else if (dynamic_cast<taoJointFree*>(joint)) {
+      clone = new taoJointFree();
+      clone->setDVar(new taoVarFree);
+    }
+    else {
+      return 0;
+    }
+    clone->reset();
+    clone->setDamping(joint->getDamping());
+    clone->setInertia(joint->getInertia());
+    return clone;
+  }
+  
+  
+  typedef std::map<taoJoint const *, double const *> locked_joint_map_t;
+  
+  
+  /**
+     Append copies of the children of source to parent. The joints
+     listed in locked are left out, their transform at the given
+     position is folded into the home frame instead, which requires
+     that a node has either all or none of its joints locked. Copies
+     of the fused nodes hosted by source are attached as well, with
+     their own mass properties, which get removed from the copy of
+     their host. The new model thus fuses them back in just like it
+     fuses the locked nodes.
+     
+     \return False if a joint type is not supported or a node is
+     only partially locked.
+  */
+  bool clone_children(taoDNode * source,
+		      taoDNode * parent,
+		      locked_joint_map_t const & locked,
+		      nodeVector_t const & fused)
+  {
+    for (size_t ii(0); ii < fused.size(); ++ii) {
+      if (fused[ii]->getDParent() == source) {
+	taoNode * fused_clone(new taoNode(parent, fused[ii]->frameHome()));
+	*fused_clone->mass() = *fused[ii]->mass();
+	*fused_clone->center() = *fused[ii]->center();
+	*fused_clone->inertia() = *fused[ii]->inertia();
+	fused_clone->setID(fused[ii]->getID());
+	fused_clone->addABNode();
+      }
+    }
+    
+    // taoNode::link() prepends, so go backwards to keep the order.
+    nodeVector_t children;
+    for (taoDNode * child(source->getDChild()); 0 != child; child = child->getDSibling()) {
+      children.push_back(child);
+    }
+    for (nodeVector_t::reverse_iterator ic(children.rbegin()); ic != children.rend(); ++ic) {
+      taoDNode * child(*ic);
+      size_t nlocked(0), njoints(0);
+      deFrame home(*child->frameHome());
+      for (taoJoint * joint(child->getJointList()); 0 != joint; joint = joint->getNext()) {
+	++njoints;
+	locked_joint_map_t::const_iterator il(locked.find(joint));
+	if (locked.end() == il) {
+	  continue;
+	}
+	++nlocked;
+	// Temporarily move the source joint to the locked position in
+	// order to get its local transform.
+	std::vector<double> current(joint->getQDim());
+	joint->getQ(&current[0]);
+	joint->setQ(il->second);
+	deFrame local;
+	local.identity();
+	joint->updateFrameLocal(&local);
+	joint->setQ(&current[0]);
+	deFrame const tmp(home);
+	home.multiply(tmp, local);
+      }
+      if ((0 != nlocked) && (njoints != nlocked)) {
+	return false;
+      }
+      
+      taoNode * clone(new taoNode(parent, &home));
+      *clone->mass() = *child->mass();
+      *clone->center() = *child->center();
+      *clone->inertia() = *child->inertia();
+      for (size_t ii(0); ii < fused.size(); ++ii) {
+	if (fused[ii]->getDParent() == child) {
+	  minitao::mergeMassProperties(clone, fused[ii], true);
+	}
+      }
+      clone->setID(child->getID());
+      if (0 == nlocked) {
+	for (taoJoint * joint(child->getJointList()); 0 != joint; joint = joint->getNext()) {
+	  taoJoint * joint_clone(clone_joint(joint));
+	  if ( ! joint_clone) {
+	    return false;
+	  }
+	  clone->addJoint(joint_clone);
+	}
+      }
+      clone->addABNode();
+      if ( ! clone_children(child, clone, locked, fused)) {
+	return false;
+      }
+    }
+    return true;
+  }
+  
+  
+  /** \return A copy of the tree, or NULL if clone_children() fails. */
+  taoDNode * clone_tree(taoDNode * root,
+			locked_joint_map_t const & locked,
+			nodeVector_t const & fused)
+  {
+    taoNodeRoot * clone(new taoNodeRoot(*root->frameHome()));
+    clone->setID(root->getID());
+    if ( ! clone_children(root, clone, locked, fused)) {
+      delete clone;
+      return 0;
+    }
+    taoDynamics::initialize(clone);
+    return clone;
+  }
+  
+}
+
+
 namespace minitao {
   
   
@@ -65,14 +282,76 @@ namespace minitao {
   Model(taoDNode * kgm_root,
 	taoDNode * cc_root)
     : kgm_root_(kgm_root),
-      cc_root_(cc_root)
+      cc_root_(cc_root),
+      gravity_valid_(false),
+      g_basis_valid_(false),
+      opspace_omega_valid_(false)
   {
+    // Links that are rigidly attached to their parent only add
+    // nodes to the sweeps, so merge them into single rigid bodies.
+    if (fuseFixedNodes(kgm_fused_, kgm_root) > 0) {
+      taoDynamics::initialize(kgm_root);
+    }
     enumerateNodes(kgm_nodes_, kgm_root);
     enumerateJoints(kgm_joints_, kgm_root);
-    ndof_ = kgm_joints_.size();
+    ndof_ = 0;
+    npos_ = 0;
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      joint_dof_.push_back(ndof_);
+      joint_position_.push_back(npos_);
+      size_t const width(kgm_joints_[ij]->getDOF());
+      dof_joint_.insert(dof_joint_.end(), width, ij);
+      ndof_ += width;
+      npos_ += kgm_joints_[ij]->getQDim();
+    }
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      active_dof_.push_back(ii);
+    }
+    for (size_t ii(0); ii < npos_; ++ii) {
+      active_position_.push_back(ii);
+    }
+    for (size_t ii(0); ii < kgm_nodes_.size(); ++ii) {
+      kgm_index_[kgm_nodes_[ii]] = ii;
+      // Joints are enumerated in the same order as nodes, so the DOF
+      // of each node follow those of the previous one.
+      node_dof_.push_back((ii > 0) ? node_dof_[ii - 1] + node_ndof_[ii - 1] : 0);
+      node_ndof_.push_back(0);
+      for (taoJoint * joint(kgm_nodes_[ii]->getJointList()); 0 != joint; joint = joint->getNext()) {
+	node_ndof_[ii] += joint->getDOF();
+      }
+    }
+    // Fused nodes are looked up via the node that carries their
+    // mass, except those attached to the root.
+    for (size_t ii(0); ii < kgm_fused_.size(); ++ii) {
+      node_index_map_t::const_iterator const ih(kgm_index_.find(kgm_fused_[ii]->getDParent()));
+      if (kgm_index_.end() != ih) {
+	kgm_index_[kgm_fused_[ii]] = ih->second;
+      }
+    }
+    compute_parents(kgm_nodes_, kgm_parent_);
+    gravity_scratch_.motion_subspace.resize(kgm_nodes_.size());
+    gravity_scratch_.mass.resize(kgm_nodes_.size());
+    gravity_scratch_.moment.resize(kgm_nodes_.size());
+    for (size_t ii(0); ii < kgm_nodes_.size(); ++ii) {
+      gravity_scratch_.motion_subspace[ii].resize(6, node_ndof_[ii]);
+    }
     if (cc_root) {
+      if (fuseFixedNodes(cc_fused_, cc_root) > 0) {
+	taoDynamics::initialize(cc_root);
+      }
       enumerateNodes(cc_nodes_, cc_root);
       enumerateJoints(cc_joints_, cc_root);
+      for (size_t ii(0); (ii < kgm_nodes_.size()) && (ii < cc_nodes_.size()); ++ii) {
+	cc_node_[kgm_nodes_[ii]] = cc_nodes_[ii];
+      }
+      for (size_t ii(0); ii < kgm_fused_.size(); ++ii) {
+	for (size_t jj(0); jj < cc_fused_.size(); ++jj) {
+	  if (cc_fused_[jj]->getID() == kgm_fused_[ii]->getID()) {
+	    cc_node_[kgm_fused_[ii]] = cc_fused_[jj];
+	    break;
+	  }
+	}
+      }
     }
   }
 
@@ -82,6 +361,12 @@ namespace minitao {
   {
     delete kgm_root_;
     delete cc_root_;
+    for (size_t ii(0); ii < kgm_fused_.size(); ++ii) {
+      delete kgm_fused_[ii];
+    }
+    for (size_t ii(0); ii < cc_fused_.size(); ++ii) {
+      delete cc_fused_[ii];
+    }
   }
   
   
@@ -98,21 +383,19 @@ namespace minitao {
   setState(State const & state)
   {
     state_ = state;
-    double const * pos(&state.position_[0]);
-    for (size_t ii(0); ii < ndof_; ++ii, ++pos) {
-      taoJoint * joint(kgm_joints_[ii]);
-      joint->setQ(pos);
+    invalidateOpSpaceFactors();
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      taoJoint * joint(kgm_joints_[ij]);
+      joint->setQ(&state.position_[joint_position_[ij]]);
       joint->zeroDQ();
       joint->zeroDDQ();
       joint->zeroTau();
     }
     if (cc_root_) {
-      pos = &state.position_[0];
-      double const * vel(&state.velocity_[0]);
-      for (size_t ii(0); ii < ndof_; ++ii, ++pos, ++vel) {
-	taoJoint * joint(cc_joints_[ii]);
-	joint->setQ(pos);
-	joint->setDQ(vel);
+      for (size_t ij(0); ij < cc_joints_.size(); ++ij) {
+	taoJoint * joint(cc_joints_[ij]);
+	joint->setQ(&state.position_[joint_position_[ij]]);
+	joint->setDQ(&state.velocity_[joint_dof_[ij]]);
 	joint->zeroDDQ();
 	joint->zeroTau();
       }
@@ -123,31 +406,145 @@ namespace minitao {
   size_t Model::
   getNNodes() const
   {
-    return ndof_;
+    return kgm_nodes_.size();
+  }
+  
+  
+  taoDNode * Model::
+  getNode(size_t index) const
+  {
+    if (index >= kgm_nodes_.size()) {
+      return 0;
+    }
+    return kgm_nodes_[index];
+  }
+  
+  
+  size_t Model::
+  getNFusedNodes() const
+  {
+    return kgm_fused_.size();
   }
   
   
   size_t Model::
   getNJoints() const
   {
-    // one day this will be different...
-    return ndof_;
+    return kgm_joints_.size();
   }
   
   
   size_t Model::
   getNDOF() const
   {
-    // one day this will be different...
     return ndof_;
   }
   
   
+  size_t Model::
+  getNPositions() const
+  {
+    return npos_;
+  }
+  
+  
+  Model * Model::
+  createReducedModel(std::vector<taoDNode const *> const & locked_nodes,
+		     std::vector<double> const & position) const
+  {
+    if (npos_ != position.size()) {
+      return 0;
+    }
+    std::vector<bool> locked(kgm_joints_.size(), false);
+    for (size_t in(0); in < locked_nodes.size(); ++in) {
+      int const index(getNodeIndex(locked_nodes[in]));
+      if ((index < 0) || (kgm_nodes_[index] != locked_nodes[in])) {
+	return 0;
+      }
+      if (0 == node_ndof_[index]) {
+	continue;
+      }
+      for (size_t ij(dof_joint_[node_dof_[index]]);
+	   (ij < kgm_joints_.size()) && (joint_dof_[ij] < node_dof_[index] + node_ndof_[index]); ++ij) {
+	locked[ij] = true;
+      }
+    }
+    
+    locked_joint_map_t kgm_locked, cc_locked;
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      if (locked[ij]) {
+	kgm_locked[kgm_joints_[ij]] = &position[joint_position_[ij]];
+	if (cc_root_) {
+	  cc_locked[cc_joints_[ij]] = &position[joint_position_[ij]];
+	}
+      }
+    }
+    taoDNode * kgm_root(clone_tree(kgm_root_, kgm_locked, kgm_fused_));
+    if ( ! kgm_root) {
+      return 0;
+    }
+    taoDNode * cc_root(0);
+    if (cc_root_) {
+      cc_root = clone_tree(cc_root_, cc_locked, cc_fused_);
+      if ( ! cc_root) {
+	delete kgm_root;
+	return 0;
+      }
+    }
+    
+    // The locked nodes have no joints in the copies, so the
+    // constructor fuses them into composite rigid bodies.
+    Model * reduced(new Model(kgm_root, cc_root));
+    reduced->active_dof_.clear();
+    reduced->active_position_.clear();
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      if (locked[ij]) {
+	continue;
+      }
+      for (size_t ii(0); ii < static_cast<size_t>(kgm_joints_[ij]->getDOF()); ++ii) {
+	size_t const dof(joint_dof_[ij] + ii);
+	if (gravity_disabled_.end() != gravity_disabled_.find(dof)) {
+	  reduced->gravity_disabled_.insert(reduced->active_dof_.size());
+	}
+	reduced->active_dof_.push_back(active_dof_[dof]);
+      }
+      for (size_t ii(0); ii < static_cast<size_t>(kgm_joints_[ij]->getQDim()); ++ii) {
+	reduced->active_position_.push_back(active_position_[joint_position_[ij] + ii]);
+      }
+    }
+    return reduced;
+  }
+  
+  
+  void Model::
+  reduceState(State const & full_state, State & state) const
+  {
+    state.time_sec_ = full_state.time_sec_;
+    state.time_usec_ = full_state.time_usec_;
+    state.position_.resize(npos_);
+    for (size_t ii(0); ii < npos_; ++ii) {
+      state.position_[ii] = full_state.position_[active_position_[ii]];
+    }
+    state.velocity_.resize(full_state.velocity_.empty() ? 0 : ndof_);
+    for (size_t ii(0); ii < state.velocity_.size(); ++ii) {
+      state.velocity_[ii] = full_state.velocity_[active_dof_[ii]];
+    }
+    state.force_.resize(full_state.force_.empty() ? 0 : ndof_);
+    for (size_t ii(0); ii < state.force_.size(); ++ii) {
+      state.force_[ii] = full_state.force_[active_dof_[ii]];
+    }
+  }
+  
+  
   void Model::
   updateKinematics()
   {
     taoDynamics::updateTransformation(kgm_root_);
+    for (size_t ii(0); ii < kgm_fused_.size(); ++ii) {
+      kgm_fused_[ii]->updateFrame();
+    }
     taoDynamics::globalJacobian(kgm_root_);
+    invalidateOpSpaceFactors();
   }
   
   
@@ -231,13 +628,15 @@ namespace minitao {
     fprintf(stderr, "computeJacobian()\ng: [% 4.2f % 4.2f % 4.2f]\n", gx, gy, gz);
 #endif // DEBUG
     
-    // \todo Implement support for more than one joint per node, and
-    // 	more than one DOF per joint.
     jacobian.resize(6, ndof_);
+    deVector6 Jg_columns[6];	// no joint has more than six DOF
     for (size_t icol(0); icol < ndof_; ++icol) {
-      deVector6 Jg_col;	// in NDOF case, this will become an array of deVector6...
-      // in NOJ case, we will have to loop over all joints of a node...
-      kgm_joints_[icol]->getJgColumns(&Jg_col);
+      // Read all columns of a joint when reaching its first DOF.
+      size_t const ij(dof_joint_[icol]);
+      if (joint_dof_[ij] == icol) {
+	kgm_joints_[ij]->getJgColumns(Jg_columns);
+      }
+      deVector6 const & Jg_col(Jg_columns[icol - joint_dof_[ij]]);
       
 #ifdef DEBUG
       fprintf(stderr, "iJg[%zu]: [ % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f]\n",
@@ -283,16 +682,137 @@ namespace minitao {
   }
   
   
+  bool Model::
+  setLinkInertia(taoDNode const * node,
+		 double mass,
+		 Vector const & com,
+		 Matrix const & inertia)
+  {
+    if ((mass < 0) || (3 != com.size()) || (3 != inertia.rows()) || (3 != inertia.cols())) {
+      return false;
+    }
+    
+    int const index(getNodeIndex(node));
+    if (index < 0) {
+      return false;
+    }
+    taoDNode * kgm_node(0);
+    if (kgm_nodes_[index] == node) {
+      kgm_node = kgm_nodes_[index];
+    }
+    else {
+      for (size_t ii(0); ii < kgm_fused_.size(); ++ii) {
+	if (kgm_fused_[ii] == node) {
+	  kgm_node = kgm_fused_[ii];
+	  break;
+	}
+      }
+    }
+    taoDNode * cc_node(0);
+    if (cc_root_) {
+      node_map_t::const_iterator const icc(cc_node_.find(kgm_node));
+      if (cc_node_.end() == icc) {
+	return false;
+      }
+      cc_node = icc->second;
+    }
+    
+    deMassProp prop;
+    deFrame com_frame;
+    com_frame.identity();
+    com_frame.translation().set(com[0], com[1], com[2]);
+    deMatrix3 com_inertia;
+    com_inertia.set(inertia.coeff(0, 0), inertia.coeff(0, 1), inertia.coeff(0, 2),
+		    inertia.coeff(1, 0), inertia.coeff(1, 1), inertia.coeff(1, 2),
+		    inertia.coeff(2, 0), inertia.coeff(2, 1), inertia.coeff(2, 2));
+    prop.inertia(&com_inertia, &com_frame);
+    if (mass > 0) {
+      prop.mass(mass, &com_frame);
+    }
+    
+    taoDNode * const nodes[] = { kgm_node, cc_node };
+    nodeVector_t const * const fused[] = { &kgm_fused_, &cc_fused_ };
+    for (size_t ii(0); ii < 2; ++ii) {
+      taoDNode * const nn(nodes[ii]);
+      if ( ! nn) {
+	continue;
+      }
+      if (nn->getJointList()) {
+	// This overwrites the contributions of the nodes merged into
+	// this one, so add them back afterwards.
+	prop.get(nn->mass(), nn->center(), nn->inertia());
+	for (size_t jj(0); jj < fused[ii]->size(); ++jj) {
+	  if ((*fused[ii])[jj]->getDParent() == nn) {
+	    mergeMassProperties(nn, (*fused[ii])[jj], false);
+	  }
+	}
+	taoABDynamics::resetInertia(nn);
+      }
+      else {
+	taoDNode * const host(nn->getDParent());
+	mergeMassProperties(host, nn, true);
+	prop.get(nn->mass(), nn->center(), nn->inertia());
+	mergeMassProperties(host, nn, false);
+	taoABDynamics::resetInertia(host);
+      }
+    }
+    
+    // Only the kinematics do not depend on the mass properties.
+    gravity_valid_ = false;
+    cc_torque_.clear();
+    c_matrix_.clear();
+    a_upper_triangular_.clear();
+    ainv_upper_triangular_.clear();
+    invalidateOpSpaceFactors();
+    return true;
+  }
+  
+  
   void Model::
   computeGravity()
   {
     g_torque_.resize(ndof_);
-    taoDynamics::invDynamics(kgm_root_, &earth_gravity);
-    for (size_t ii(0); ii < ndof_; ++ii) {
-      // If we have a joint with more than one NDOF this is probably
-      // going to blow up or do the wrong thing.
-      kgm_joints_[ii]->getTau(&g_torque_[ii]);
+    g_basis_valid_ = global_gravity_basis(kgm_nodes_, kgm_parent_, gravity_scratch_, g_basis_);
+    if (g_basis_valid_) {
+      Eigen::Vector3d const gg(earth_gravity[0], earth_gravity[1], earth_gravity[2]);
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	g_torque_[ii] = g_basis_.row(ii).dot(gg);
+      }
+    }
+    else {
+      // Fall back to inverse dynamics for trees that have joints
+      // which the gravity kernel does not know about. The basis
+      // costs three more sweeps, so it is left to
+      // computeGravityBasis().
+      taoDynamics::invDynamics(kgm_root_, &earth_gravity);
+      for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+	kgm_joints_[ij]->getTau(&g_torque_[joint_dof_[ij]]);
+	kgm_joints_[ij]->zeroTau();
+      }
+    }
+    gravity_valid_ = true;
+  }
+  
+  
+  void Model::
+  computeGravityBasis() const
+  {
+    if (g_basis_valid_) {
+      return;
+    }
+    g_basis_.resize(ndof_, 3);
+    for (int icol(0); icol < 3; ++icol) {
+      deVector3 unit_gravity(0, 0, 0);
+      unit_gravity[icol] = 1;
+      taoDynamics::invDynamics(kgm_root_, &unit_gravity);
+      for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+	// The rows of a column are contiguous, so multi-DOF joints
+	// can write all their entries at once.
+	kgm_joints_[ij]->getTau(&g_basis_.coeffRef(joint_dof_[ij], icol));
+	kgm_joints_[ij]->zeroTau();
+      }
     }
+    g_basis_valid_ = true;
   }
   
   
@@ -324,7 +844,7 @@ namespace minitao {
   bool Model::
   getGravity(Vector & gravity) const
   {
-    if (g_torque_.empty()) {
+    if ( ! gravity_valid_) {
       return false;
     }
     gravity.resize(g_torque_.size());
@@ -339,16 +859,41 @@ namespace minitao {
   }
   
   
+  bool Model::
+  getGravity(Vector const & g_vector, Vector & gravity) const
+  {
+    if (( ! gravity_valid_) || (3 != g_vector.size())) {
+      return false;
+    }
+    computeGravityBasis();
+    gravity = g_basis_ * g_vector;
+    for (dof_set_t::const_iterator idof(gravity_disabled_.begin()); idof != gravity_disabled_.end(); ++idof) {
+      gravity[*idof] = 0;
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  getGravityBasis(Matrix & basis) const
+  {
+    if ( ! gravity_valid_) {
+      return false;
+    }
+    computeGravityBasis();
+    basis = g_basis_;
+    return true;
+  }
+  
+  
   void Model::
   computeCoriolisCentrifugal()
   {
     if (cc_root_) {
       cc_torque_.resize(ndof_);
       taoDynamics::invDynamics(cc_root_, &zero_gravity);
-      for (size_t ii(0); ii < ndof_; ++ii) {
-	// If we have a joint with more than one NDOF this is probably
-	// going to blow up or do the wrong thing.
-	cc_joints_[ii]->getTau(&cc_torque_[ii]);
+      for (size_t ij(0); ij < cc_joints_.size(); ++ij) {
+	cc_joints_[ij]->getTau(&cc_torque_[joint_dof_[ij]]);
       }
     }
   }
@@ -371,6 +916,73 @@ namespace minitao {
   }
   
   
+  void Model::
+  computeCoriolisMatrix()
+  {
+    // Fill c_matrix_ from scratch, leaving it empty in case of
+    // failure so that getCoriolisMatrix() can tell.
+    c_matrix_.clear();
+    if (ndof_ != state_.velocity_.size()) {
+      return;
+    }
+    Vector const zero(Vector::Zero(ndof_));
+    Matrix coriolis;
+    if ( ! global_rnea(kgm_nodes_, &state_.velocity_[0], zero.data(),
+		       0, 0, 0, 0, &coriolis)) {
+      return;
+    }
+    c_matrix_.resize(ndof_ * ndof_);
+    for (size_t irow(0); irow < ndof_; ++irow) {
+      for (size_t icol(0); icol < ndof_; ++icol) {
+	c_matrix_[irow * ndof_ + icol] = coriolis.coeff(irow, icol);
+      }
+    }
+  }
+  
+  
+  bool Model::
+  getCoriolisMatrix(Matrix & coriolis) const
+  {
+    if (c_matrix_.empty()) {
+      return false;
+    }
+    
+    coriolis.resize(ndof_, ndof_);
+    for (size_t irow(0); irow < ndof_; ++irow) {
+      for (size_t icol(0); icol < ndof_; ++icol) {
+	coriolis.coeffRef(irow, icol) = c_matrix_[irow * ndof_ + icol];
+      }
+    }
+    
+    return true;
+  }
+  
+  
+  bool Model::
+  computeKineticEnergy(double & energy) const
+  {
+    if (ndof_ != state_.velocity_.size()) {
+      return false;
+    }
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->setDQ(&state_.velocity_[joint_dof_[ij]]);
+    }
+    // The energy traversal computes the node velocities from the
+    // local transforms, which only the dynamics sweeps update.
+    taoABDynamics::updateLocalXTreeOut(kgm_root_);
+    energy = taoDynamics::kineticEnergy(kgm_root_);
+    resetSweep();
+    return true;
+  }
+  
+  
+  double Model::
+  computePotentialEnergy() const
+  {
+    return taoDynamics::potentialEnergy(kgm_root_, &earth_gravity);
+  }
+  
+  
   void Model::
   computeMassInertia()
   {
@@ -378,9 +990,10 @@ namespace minitao {
       a_upper_triangular_.resize(ndof_ * (ndof_ + 1) / 2);
     }
     
-    deFloat const one(1);
+    std::vector<double> column(ndof_);
     for (size_t irow(0); irow < ndof_; ++irow) {
-      taoJoint * joint(kgm_joints_[irow]);
+      size_t const ij(dof_joint_[irow]);
+      taoJoint * joint(kgm_joints_[ij]);
       
       // Compute one column of A by solving inverse dynamics of the
       // corresponding joint having a unit acceleration, while all the
@@ -388,22 +1001,26 @@ namespace minitao {
       // has zero speeds, thus the Coriolis-centrifgual effects are
       // zero, and by using zero gravity we get pure system dynamics:
       // force = mass * acceleration (in matrix form).
-      joint->setDDQ(&one);
+      deFloat unit[6] = { 0, 0, 0, 0, 0, 0 };
+      unit[irow - joint_dof_[ij]] = 1;
+      joint->setDDQ(unit);
       taoDynamics::invDynamics(kgm_root_, &zero_gravity);
       joint->zeroDDQ();
       
       // Retrieve the column of A by reading the joint torques
       // required for the column-selecting unit acceleration (into a
       // flattened upper triangular matrix).
-      
+      for (size_t jj(0); jj <= ij; ++jj) {
+	kgm_joints_[jj]->getTau(&column[joint_dof_[jj]]);
+      }
       for (size_t icol(0); icol <= irow; ++icol) {
-	kgm_joints_[icol]->getTau(&a_upper_triangular_[squareToTriangularIndex(irow, icol, ndof_)]);
+	a_upper_triangular_[squareToTriangularIndex(irow, icol, ndof_)] = column[icol];
       }
     }
     
     // Reset all the torques.
-    for (size_t ii(0); ii < ndof_; ++ii) {
-      kgm_joints_[ii]->zeroTau();
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->zeroTau();
     }
   }
   
@@ -436,9 +1053,10 @@ namespace minitao {
       ainv_upper_triangular_.resize(ndof_ * (ndof_ + 1) / 2);
     }
     
-    deFloat const one(1);
+    std::vector<double> column(ndof_);
     for (size_t irow(0); irow < ndof_; ++irow) {
-      taoJoint * joint(kgm_joints_[irow]);
+      size_t const ij(dof_joint_[irow]);
+      taoJoint * joint(kgm_joints_[ij]);
       
       // Compute one column of Ainv by solving forward dynamics of the
       // corresponding joint having a unit torque, while all the
@@ -446,21 +1064,26 @@ namespace minitao {
       // it has zero speeds, thus the Coriolis-centrifgual effects are
       // zero, and by using zero gravity we get pure system dynamics:
       // acceleration = mass_inv * force (in matrix form).
-      joint->setTau(&one);
+      deFloat unit[6] = { 0, 0, 0, 0, 0, 0 };
+      unit[irow - joint_dof_[ij]] = 1;
+      joint->setTau(unit);
       taoDynamics::fwdDynamics(kgm_root_, &zero_gravity);
       joint->zeroTau();
       
       // Retrieve the column of Ainv by reading the joint
       // accelerations generated by the column-selecting unit torque
       // (into a flattened upper triangular matrix).
+      for (size_t jj(0); jj <= ij; ++jj) {
+	kgm_joints_[jj]->getDDQ(&column[joint_dof_[jj]]);
+      }
       for (size_t icol(0); icol <= irow; ++icol) {
-	kgm_joints_[icol]->getDDQ(&ainv_upper_triangular_[squareToTriangularIndex(irow, icol, ndof_)]);
+	ainv_upper_triangular_[squareToTriangularIndex(irow, icol, ndof_)] = column[icol];
       }
     }
     
     // Reset all the accelerations.
-    for (size_t ii(0); ii < ndof_; ++ii) {
-      kgm_joints_[ii]->zeroDDQ();
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->zeroDDQ();
     }
   }
   
@@ -486,10 +1109,1108 @@ namespace minitao {
   }
   
   
-  taoDNode * Model::
-  findNodeByID(int id) const
+  Model::ExternalWrench::
+  ExternalWrench(taoDNode * node_,
+		 Vector const & point_,
+		 Vector const & force_,
+		 Vector const & moment_)
+    : node(node_),
+      point(point_),
+      force(force_),
+      moment(moment_)
   {
-    for (nodeVector_t::const_iterator in(kgm_nodes_.begin()); in != kgm_nodes_.end(); ++in) {
+  }
+  
+  
+  bool Model::
+  computeInverseDynamics(Vector const & acceleration,
+			 external_wrench_list_t const & external_wrenches,
+			 Vector & tau)
+  {
+    if ((ndof_ != static_cast<size_t>(acceleration.size())) || (ndof_ != state_.velocity_.size())) {
+      return false;
+    }
+    for (external_wrench_list_t::const_iterator iw(external_wrenches.begin());
+	 iw != external_wrenches.end(); ++iw) {
+      if ((getNodeIndex(iw->node) < 0)
+	  || (3 != iw->point.size()) || (3 != iw->force.size()) || (3 != iw->moment.size())) {
+	return false;
+      }
+    }
+    
+    // TAO wants external forces in the local frame, with the moment
+    // taken about the node origin. Several wrenches can act on the
+    // same node, so accumulate.
+    for (external_wrench_list_t::const_iterator iw(external_wrenches.begin());
+	 iw != external_wrenches.end(); ++iw) {
+      taoDNode * const node(getHostNode(iw->node));
+      Eigen::Matrix3d const rot(global_rotation(node));
+      Eigen::Vector3d const force(iw->force[0], iw->force[1], iw->force[2]);
+      Eigen::Vector3d const arm(Eigen::Vector3d(iw->point[0], iw->point[1], iw->point[2])
+				- global_translation(node));
+      Eigen::Vector3d const moment(Eigen::Vector3d(iw->moment[0], iw->moment[1], iw->moment[2])
+				   + arm.cross(force));
+      Eigen::Vector3d const lforce(rot.transpose() * force);
+      Eigen::Vector3d const lmoment(rot.transpose() * moment);
+      deVector6 & fext(*node->force());
+      for (int ii(0); ii < 3; ++ii) {
+	fext[0][ii] += lforce[ii];
+	fext[1][ii] += lmoment[ii];
+      }
+    }
+    
+    // Temporarily give the KGM tree the actual velocity and desired
+    // acceleration. It has to be put back to rest afterwards,
+    // because computeMassInertia() and computeInverseMassInertia()
+    // rely on zero speeds.
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->setDQ(&state_.velocity_[joint_dof_[ij]]);
+      kgm_joints_[ij]->setDDQ(acceleration.data() + joint_dof_[ij]);
+    }
+    
+    taoDynamics::invDynamics(kgm_root_, &earth_gravity);
+    
+    tau.resize(ndof_);
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      taoJoint * joint(kgm_joints_[ij]);
+      joint->getTau(&tau[joint_dof_[ij]]);
+      joint->zeroDQ();
+      joint->zeroDDQ();
+      joint->zeroTau();
+    }
+    for (external_wrench_list_t::const_iterator iw(external_wrenches.begin());
+	 iw != external_wrenches.end(); ++iw) {
+      getHostNode(iw->node)->force()->zero();
+    }
+    
+    return true;
+  }
+  
+  
+  bool Model::
+  computeInverseDynamics(Vector const & acceleration,
+			 Vector & tau)
+  {
+    return computeInverseDynamics(acceleration, external_wrench_list_t(), tau);
+  }
+  
+  
+  bool Model::
+  computeForwardDynamics(State const & state,
+			 Vector const & tau,
+			 Vector & acceleration)
+  {
+    if ((ndof_ != static_cast<size_t>(tau.size()))
+	|| (npos_ != state.position_.size())
+	|| (ndof_ != state.velocity_.size())) {
+      return false;
+    }
+    
+    // Only redo the kinematics if the position differs from the one
+    // the KGM tree currently holds.
+    bool const moved(state.position_ != state_.position_);
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      taoJoint * joint(kgm_joints_[ij]);
+      if (moved) {
+	joint->setQ(&state.position_[joint_position_[ij]]);
+      }
+      joint->setDQ(&state.velocity_[joint_dof_[ij]]);
+      joint->setTau(tau.data() + joint_dof_[ij]);
+    }
+    if (moved) {
+      taoDynamics::updateTransformation(kgm_root_);
+    }
+    
+    taoDynamics::fwdDynamics(kgm_root_, &earth_gravity);
+    
+    acceleration.resize(ndof_);
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      taoJoint * joint(kgm_joints_[ij]);
+      joint->getDDQ(&acceleration[joint_dof_[ij]]);
+      joint->zeroDQ();
+      joint->zeroDDQ();
+      joint->zeroTau();
+    }
+    
+    if (moved && (npos_ == state_.position_.size())) {
+      for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+	kgm_joints_[ij]->setQ(&state_.position_[joint_position_[ij]]);
+      }
+      taoDynamics::updateTransformation(kgm_root_);
+    }
+    
+    return true;
+  }
+  
+  
+  bool Model::
+  computeMassInertiaProduct(Vector const & xx,
+			    Vector & result) const
+  {
+    if (ndof_ != static_cast<size_t>(xx.size())) {
+      return false;
+    }
+    // Same as one column of computeMassInertia(), but with an
+    // arbitrary acceleration instead of a unit vector. The KGM tree
+    // is only used as scratch space and is left at rest.
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->setDDQ(xx.data() + joint_dof_[ij]);
+    }
+    taoDynamics::invDynamics(kgm_root_, &zero_gravity);
+    result.resize(ndof_);
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->getTau(&result[joint_dof_[ij]]);
+      kgm_joints_[ij]->zeroDDQ();
+      kgm_joints_[ij]->zeroTau();
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeInverseMassInertiaProduct(Vector const & yy,
+				   Vector & result) const
+  {
+    if (ndof_ != static_cast<size_t>(yy.size())) {
+      return false;
+    }
+    // Same as one column of computeInverseMassInertia(), but with an
+    // arbitrary torque instead of a unit vector.
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->setTau(yy.data() + joint_dof_[ij]);
+    }
+    taoDynamics::fwdDynamics(kgm_root_, &zero_gravity);
+    result.resize(ndof_);
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->getDDQ(&result[joint_dof_[ij]]);
+      kgm_joints_[ij]->zeroDDQ();
+      kgm_joints_[ij]->zeroTau();
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeMassInertiaProduct(Matrix const & xx,
+			    Matrix & result) const
+  {
+    if (ndof_ != static_cast<size_t>(xx.rows())) {
+      return false;
+    }
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    global_mass_inertia_product(tree, xx, result);
+    return true;
+  }
+  
+  
+  bool Model::
+  computeInverseMassInertiaProduct(Matrix const & yy,
+				   Matrix & result) const
+  {
+    if (ndof_ != static_cast<size_t>(yy.rows())) {
+      return false;
+    }
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    articulated_factors_s factors;
+    compute_articulated_factors(tree, factors);
+    global_inverse_mass_inertia_product(tree, factors, yy, result);
+    return true;
+  }
+  
+  
+  bool Model::
+  computeHybridDynamics(std::vector<bool> const & acceleration_given,
+			Vector & acceleration,
+			Vector & tau) const
+  {
+    if ((ndof_ != acceleration_given.size())
+	|| (ndof_ != static_cast<size_t>(acceleration.size()))
+	|| (ndof_ != static_cast<size_t>(tau.size()))
+	|| (ndof_ != state_.velocity_.size())) {
+      return false;
+    }
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    global_hybrid_dynamics(tree, &state_.velocity_[0], acceleration_given, acceleration, tau);
+    return true;
+  }
+  
+  
+  bool Model::
+  computeInverseDynamicsDerivatives(Vector const & acceleration,
+				    Matrix & dtau_dposition,
+				    Matrix & dtau_dvelocity) const
+  {
+    if ((ndof_ != static_cast<size_t>(acceleration.size())) || (ndof_ != state_.velocity_.size())) {
+      return false;
+    }
+    return global_rnea(kgm_nodes_, &state_.velocity_[0], acceleration.data(),
+		       0, &dtau_dposition, &dtau_dvelocity, 0, 0);
+  }
+  
+  
+  bool Model::
+  computeForwardDynamicsDerivatives(Vector const & tau,
+				    Matrix & dacc_dposition,
+				    Matrix & dacc_dvelocity) const
+  {
+    if ((ndof_ != static_cast<size_t>(tau.size())) || (ndof_ != state_.velocity_.size())) {
+      return false;
+    }
+    
+    // Bias torque from one sweep, then evaluate the inverse dynamics
+    // derivatives at the resulting acceleration:
+    // d(acc) = - inverse(A) * d(tau), with tau held constant. All
+    // products with inverse(A) share the articulated-body factors,
+    // so nothing gets factored densely.
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    articulated_factors_s factors;
+    compute_articulated_factors(tree, factors);
+    Vector const zero(Vector::Zero(ndof_));
+    Vector bias;
+    if ( ! global_rnea(kgm_nodes_, &state_.velocity_[0], zero.data(),
+		       &bias, 0, 0, 0, 0)) {
+      return false;
+    }
+    Matrix acceleration;
+    global_inverse_mass_inertia_product(tree, factors, tau - bias, acceleration);
+    Matrix dtau_dposition, dtau_dvelocity;
+    if ( ! global_rnea(kgm_nodes_, &state_.velocity_[0], acceleration.data(),
+		       0, &dtau_dposition, &dtau_dvelocity, 0, 0)) {
+      return false;
+    }
+    Matrix dtau(ndof_, 2 * ndof_);
+    dtau.leftCols(ndof_) = dtau_dposition;
+    dtau.rightCols(ndof_) = dtau_dvelocity;
+    Matrix dacc;
+    global_inverse_mass_inertia_product(tree, factors, dtau, dacc);
+    dacc_dposition = - dacc.leftCols(ndof_);
+    dacc_dvelocity = - dacc.rightCols(ndof_);
+    return true;
+  }
+  
+  
+  bool Model::
+  computeRegressor(Vector const & acceleration,
+		   Matrix & regressor) const
+  {
+    if ((ndof_ != static_cast<size_t>(acceleration.size())) || (ndof_ != state_.velocity_.size())) {
+      return false;
+    }
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    global_regressor(tree, kgm_nodes_, &state_.velocity_[0], acceleration.data(), true, regressor);
+    return true;
+  }
+  
+  
+  void Model::
+  getInertialParameters(Vector & parameters) const
+  {
+    parameters.resize(10 * kgm_nodes_.size());
+    for (size_t ii(0); ii < kgm_nodes_.size(); ++ii) {
+      taoDNode * const node(kgm_nodes_[ii]);
+      double const mass(*node->mass());
+      deVector3 const & com(*node->center());
+      deMatrix3 const & inertia(*node->inertia());
+      double * const pp(parameters.data() + 10 * ii);
+      pp[0] = mass;
+      pp[1] = mass * com[0];
+      pp[2] = mass * com[1];
+      pp[3] = mass * com[2];
+      pp[4] = inertia[0][0];
+      pp[5] = inertia[0][1];
+      pp[6] = inertia[0][2];
+      pp[7] = inertia[1][1];
+      pp[8] = inertia[1][2];
+      pp[9] = inertia[2][2];
+    }
+  }
+  
+  
+  bool Model::
+  computeEnsembleDynamics(Matrix const & parameters,
+			  Matrix & gravity,
+			  Matrix & coriolis_centrifugal,
+			  std::vector<Matrix> & mass_inertia) const
+  {
+    if ((10 * kgm_nodes_.size() != static_cast<size_t>(parameters.rows()))
+	|| (ndof_ != state_.velocity_.size())) {
+      return false;
+    }
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    
+    // The dynamics are linear in the inertial parameters, so each
+    // quantity is one matrix product for the whole ensemble.
+    Vector const zero(Vector::Zero(ndof_));
+    Matrix regressor;
+    global_regressor(tree, kgm_nodes_, zero.data(), zero.data(), true, regressor);
+    gravity = regressor * parameters;
+    for (dof_set_t::const_iterator idof(gravity_disabled_.begin()); idof != gravity_disabled_.end(); ++idof) {
+      gravity.row(*idof).setZero();
+    }
+    global_regressor(tree, kgm_nodes_, &state_.velocity_[0], zero.data(), false, regressor);
+    coriolis_centrifugal = regressor * parameters;
+    
+    global_mass_inertia_regressor(tree, kgm_nodes_, regressor);
+    Matrix const packed(regressor * parameters);
+    mass_inertia.resize(parameters.cols());
+    for (size_t ik(0); ik < mass_inertia.size(); ++ik) {
+      Matrix & aa(mass_inertia[ik]);
+      aa.resize(ndof_, ndof_);
+      for (size_t irow(0); irow < ndof_; ++irow) {
+	for (size_t icol(0); icol <= irow; ++icol) {
+	  aa.coeffRef(irow, icol) = packed.coeff(irow * (irow + 1) / 2 + icol, ik);
+	  aa.coeffRef(icol, irow) = aa.coeff(irow, icol);
+	}
+	aa.coeffRef(irow, irow) += tree.armature[irow];
+      }
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeOpSpaceInertia(taoDNode const * node,
+			Vector const & global_point,
+			Matrix & lambda)
+  {
+    taoDNode * const host(getHostNode(node));
+    Eigen::LLT<Matrix> const * factor(getOpSpaceFactor(host));
+    if ( ! factor) {
+      return false;
+    }
+    
+    // Shift the reference point from the node origin to the given
+    // point: xdd_point = shift * xdd_origin + (velocity terms), with
+    // shift = [ I  -[r]x ; 0  I ], hence
+    // Lambda_point = shift^-T * Lambda_origin * shift^-1.
+    Eigen::Vector3d const rr(Eigen::Vector3d(global_point[0], global_point[1], global_point[2])
+			     - global_translation(host));
+    Matrix inverse_shift(Matrix::Identity(6, 6));
+    inverse_shift.block(0, 3, 3, 3) = skew(rr);
+    lambda = inverse_shift.transpose() * factor->solve(inverse_shift);
+    return true;
+  }
+  
+  
+  bool Model::
+  computeOpSpaceBias(taoDNode const * node,
+		     Vector const & global_point,
+		     Vector & coriolis_centrifugal,
+		     Vector & gravity)
+  {
+    if (ndof_ != state_.velocity_.size()) {
+      return false;
+    }
+    Matrix lambda;
+    if ( ! computeOpSpaceInertia(node, global_point, lambda)) {
+      return false;
+    }
+    
+    // With zero joint torque, the operational-space force is zero as
+    // well, so Lambda * xdd_free + mu + p = 0 for the free
+    // acceleration xdd_free that is due to velocity or gravity.
+    Eigen::Vector3d const point(global_point[0], global_point[1], global_point[2]);
+    Vector free_acceleration;
+    sweepForwardDynamics(true, false, 0);
+    getSweepAcceleration(node, point, free_acceleration);
+    resetSweep();
+    coriolis_centrifugal = - lambda * free_acceleration;
+    sweepForwardDynamics(false, true, 0);
+    getSweepAcceleration(node, point, free_acceleration);
+    resetSweep();
+    gravity = - lambda * free_acceleration;
+    return true;
+  }
+  
+  
+  bool Model::
+  computeCenterOfMass(Vector & com) const
+  {
+    double mass(0);
+    Eigen::Vector3d moment(Eigen::Vector3d::Zero());
+    for (size_t ii(0); ii < kgm_nodes_.size(); ++ii) {
+      taoDNode * node(kgm_nodes_[ii]);
+      deVector3 const & lcom(*node->center());
+      mass += *node->mass();
+      moment += *node->mass() * (global_translation(node)
+				 + global_rotation(node) * Eigen::Vector3d(lcom[0], lcom[1], lcom[2]));
+    }
+    if (mass <= 0) {
+      return false;
+    }
+    com = moment / mass;
+    return true;
+  }
+  
+  
+  bool Model::
+  computeCenterOfMass(Vector & com, Matrix & jacobian) const
+  {
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    double mass;
+    Eigen::Vector3d gcom;
+    Matrix momentum_matrix;
+    if ( ! global_centroidal(tree, 0, mass, gcom, momentum_matrix, 0)) {
+      return false;
+    }
+    com = gcom;
+    jacobian = momentum_matrix.topRows(3) / mass;
+    return true;
+  }
+  
+  
+  bool Model::
+  computeCentroidalMomentum(Matrix & momentum_matrix,
+			    Vector & momentum_bias) const
+  {
+    if (ndof_ != state_.velocity_.size()) {
+      return false;
+    }
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    double mass;
+    Eigen::Vector3d com;
+    return global_centroidal(tree, &state_.velocity_[0], mass, com, momentum_matrix, &momentum_bias);
+  }
+  
+  
+  Model::Contact::
+  Contact(taoDNode const * node_,
+	  Vector const & point_)
+    : node(node_),
+      point(point_)
+  {
+  }
+  
+  
+  bool Model::
+  computeDelassusMatrix(contact_list_t const & contacts,
+			Matrix & delassus) const
+  {
+    std::vector<size_t> contact_node(contacts.size());
+    std::vector<spatial_block_t> contact_map(contacts.size());
+    for (size_t ic(0); ic < contacts.size(); ++ic) {
+      int const index(getNodeIndex(contacts[ic].node));
+      if (index < 0) {
+	return false;
+      }
+      // the last DOF of a node carries its inertia in global_tree_s
+      contact_node[ic] = node_dof_[index] + node_ndof_[index] - 1;
+      Vector const & point(contacts[ic].point);
+      contact_map[ic] = point_force_map(Eigen::Vector3d(point[0], point[1], point[2]), false);
+    }
+    
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    articulated_factors_s factors;
+    compute_articulated_factors(tree, factors);
+    global_delassus(tree, factors, contact_node, contact_map, delassus);
+    return true;
+  }
+  
+  
+  Model::EndEffector::
+  EndEffector(taoDNode const * node_,
+	      Vector const & point_,
+	      Vector const & acceleration_)
+    : node(node_),
+      point(point_),
+      acceleration(acceleration_)
+  {
+  }
+  
+  
+  bool Model::
+  computeOpSpaceInverseDynamics(end_effector_list_t const & end_effectors,
+				Vector const & tau_null,
+				Vector & tau)
+  {
+    if ((ndof_ != state_.velocity_.size()) || (ndof_ != static_cast<size_t>(tau_null.size()))) {
+      return false;
+    }
+    
+    size_t const nee(end_effectors.size());
+    std::vector<size_t> ee_node(nee);
+    std::vector<Eigen::Vector3d> ee_point(nee);
+    std::vector<spatial_block_t> ee_map(nee);
+    int nrows(0);
+    for (size_t ie(0); ie < nee; ++ie) {
+      EndEffector const & ee(end_effectors[ie]);
+      int const index(getNodeIndex(ee.node));
+      if ((index < 0) || ((3 != ee.acceleration.size()) && (6 != ee.acceleration.size()))) {
+	return false;
+      }
+      ee_node[ie] = node_dof_[index] + node_ndof_[index] - 1;
+      ee_point[ie] = Eigen::Vector3d(ee.point[0], ee.point[1], ee.point[2]);
+      ee_map[ie] = point_force_map(ee_point[ie], 6 == ee.acceleration.size());
+      nrows += ee.acceleration.size();
+    }
+    
+    global_tree_s tree;
+    if ( ! compute_global_tree(kgm_nodes_, tree)) {
+      return false;
+    }
+    articulated_factors_s factors;
+    compute_articulated_factors(tree, factors);
+    Matrix omega;
+    global_delassus(tree, factors, ee_node, ee_map, omega);
+    Eigen::LLT<Matrix> const llt(omega);
+    if (Eigen::Success != llt.info()) {
+      return false;
+    }
+    
+    // The task forces have to make up for the difference between the
+    // desired accelerations and those that tau_null produces on its
+    // own, which includes gravity and velocity effects.
+    Vector acceleration_error(nrows);
+    sweepForwardDynamics(true, true, &tau_null);
+    for (int ie(0), offset(0); ie < static_cast<int>(nee); offset += end_effectors[ie].acceleration.size(), ++ie) {
+      Vector acc;
+      getSweepAcceleration(end_effectors[ie].node, ee_point[ie], acc);
+      int const size(end_effectors[ie].acceleration.size());
+      acceleration_error.segment(offset, size) = end_effectors[ie].acceleration - acc.head(size);
+    }
+    resetSweep();
+    Vector const force(llt.solve(acceleration_error));
+    
+    std::vector<spatial_vector_t> spatial_force(nee);
+    for (int ie(0), offset(0); ie < static_cast<int>(nee); offset += ee_map[ie].cols(), ++ie) {
+      spatial_force[ie] = ee_map[ie] * force.segment(offset, ee_map[ie].cols());
+    }
+    tau = tau_null;
+    global_add_force_torque(tree, ee_node, spatial_force, tau);
+    return true;
+  }
+  
+  
+  Eigen::LLT<Matrix> const * Model::
+  getOpSpaceFactor(taoDNode const * node)
+  {
+    if ( ! node) {
+      return 0;
+    }
+    opspace_factor_s & factor(opspace_factor_[node]);
+    if ( ! factor.valid) {
+      if ( ! opspace_omega_valid_) {
+	// The Omega recursion uses the articulated-body quantities of
+	// the last forward dynamics sweep, which only depend on the
+	// joint positions. Velocity and torque are zero at this point.
+	taoDynamics::fwdDynamics(kgm_root_, &zero_gravity);
+	for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+	  kgm_joints_[ij]->zeroDDQ();
+	}
+	taoABDynamics::opSpaceInertiaMatrixOut(kgm_root_);
+	opspace_omega_valid_ = true;
+      }
+      
+      // TAO stores Omega in node coordinates, in [linear; angular]
+      // blocks, so rotating it into global coordinates is a
+      // similarity transform with diag(R, R).
+      taoDNode * tao_node(const_cast<taoDNode*>(node));
+      deMatrix6 const & tao_omega(*tao_node->getABNode()->Omega());
+      spatial_matrix_t omega;
+      for (int ii(0); ii < 6; ++ii) {
+	for (int jj(0); jj < 6; ++jj) {
+	  omega(ii, jj) = tao_omega.elementAt(ii, jj);
+	}
+      }
+      spatial_matrix_t rotation(spatial_matrix_t::Zero());
+      rotation.topLeftCorner<3, 3>() = global_rotation(tao_node);
+      rotation.bottomRightCorner<3, 3>() = rotation.topLeftCorner<3, 3>();
+      factor.llt.compute(rotation * omega * rotation.transpose());
+      factor.valid = true;
+    }
+    if (Eigen::Success != factor.llt.info()) {
+      return 0;
+    }
+    return &factor.llt;
+  }
+  
+  
+  void Model::
+  invalidateOpSpaceFactors()
+  {
+    for (opspace_factor_map_t::iterator ifactor(opspace_factor_.begin());
+	 ifactor != opspace_factor_.end(); ++ifactor) {
+      ifactor->second.valid = false;
+    }
+    opspace_omega_valid_ = false;
+  }
+  
+  
+  void Model::
+  sweepForwardDynamics(bool with_velocity,
+		       bool with_gravity,
+		       Vector const * tau)
+  {
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      if (with_velocity) {
+	kgm_joints_[ij]->setDQ(&state_.velocity_[joint_dof_[ij]]);
+      }
+      if (tau) {
+	kgm_joints_[ij]->setTau(tau->data() + joint_dof_[ij]);
+      }
+    }
+    taoDynamics::fwdDynamics(kgm_root_, with_gravity ? &earth_gravity : &zero_gravity);
+  }
+  
+  
+  void Model::
+  getSweepAcceleration(taoDNode const * node,
+		       Eigen::Vector3d const & global_point,
+		       Vector & acceleration) const
+  {
+    taoDNode * tao_node(getHostNode(node));
+    acceleration = node_point_acceleration(tao_node, *tao_node->getABNode()->A(), global_point);
+  }
+  
+  
+  void Model::
+  sweepBiasAcceleration() const
+  {
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->setDQ(&state_.velocity_[joint_dof_[ij]]);
+    }
+    // The inverse dynamics sweep computes the node velocities and the
+    // velocity-product accelerations that the bias acceleration
+    // recursion is built from.
+    taoDynamics::invDynamics(kgm_root_, &zero_gravity);
+    taoABDynamics::biasAccelerationOut(kgm_root_);
+  }
+  
+  
+  void Model::
+  getSweepBiasAcceleration(taoDNode const * node,
+			   Eigen::Vector3d const & global_point,
+			   Vector & jdot_qdot) const
+  {
+    taoDNode * tao_node(getHostNode(node));
+    jdot_qdot = node_point_acceleration(tao_node, *tao_node->getABNode()->H(), global_point);
+  }
+  
+  
+  bool Model::
+  computeJdotQdot(taoDNode const * node,
+		  Vector const & global_point,
+		  Vector & jdot_qdot) const
+  {
+    if ((ndof_ != state_.velocity_.size()) || (getNodeIndex(node) < 0)) {
+      return false;
+    }
+    sweepBiasAcceleration();
+    getSweepBiasAcceleration(node, Eigen::Vector3d(global_point[0], global_point[1], global_point[2]),
+			     jdot_qdot);
+    resetSweep();
+    return true;
+  }
+  
+  
+  bool Model::
+  computeJdotQdot(node_point_list_t const & points,
+		  SparseJacobian::part_t part,
+		  Vector & jdot_qdot) const
+  {
+    if (ndof_ != state_.velocity_.size()) {
+      return false;
+    }
+    for (size_t ip(0); ip < points.size(); ++ip) {
+      if (getNodeIndex(points[ip].node) < 0) {
+	return false;
+      }
+    }
+    
+    sweepBiasAcceleration();
+    size_t const nrows((SparseJacobian::FULL == part) ? 6 : 3);
+    size_t const first_row((SparseJacobian::ORIENTATION == part) ? 3 : 0);
+    jdot_qdot.resize(nrows * points.size());
+    for (size_t ip(0); ip < points.size(); ++ip) {
+      Transform global_frame;
+      computeGlobalFrame(points[ip].node, points[ip].local_point, global_frame);
+      Vector bias;
+      getSweepBiasAcceleration(points[ip].node, global_frame.translation(), bias);
+      jdot_qdot.segment(nrows * ip, nrows) = bias.segment(first_row, nrows);
+    }
+    resetSweep();
+    return true;
+  }
+  
+  
+  void Model::
+  resetSweep() const
+  {
+    for (size_t ij(0); ij < kgm_joints_.size(); ++ij) {
+      kgm_joints_[ij]->zeroDQ();
+      kgm_joints_[ij]->zeroDDQ();
+      kgm_joints_[ij]->zeroTau();
+    }
+  }
+  
+  
+  bool Model::
+  computeSparseJacobian(taoDNode const * node,
+			Vector const & global_point,
+			SparseJacobian::part_t part,
+			SparseJacobian & jacobian) const
+  {
+    if (getNodeIndex(node) < 0) {
+      return false;
+    }
+    
+    getPathDOF(node, jacobian.dof_);
+    
+    // Same as computeJacobian(), but only for the listed columns.
+    Eigen::Vector3d const gpos(global_point[0], global_point[1], global_point[2]);
+    jacobian.block_.resize((SparseJacobian::FULL == part) ? 6 : 3, jacobian.dof_.size());
+    for (size_t icol(0); icol < jacobian.dof_.size(); ++icol) {
+      size_t const dof(jacobian.dof_[icol]);
+      size_t const ij(dof_joint_[dof]);
+      jacobian.block_.col(icol)
+	= point_jacobian_column(read_jacobian_column(kgm_joints_[ij], dof - joint_dof_[ij]), gpos, part);
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeJacobianDerivatives(taoDNode const * node,
+			     Vector const & global_point,
+			     std::vector<Matrix> & derivatives) const
+  {
+    if ((getNodeIndex(node) < 0) || (3 != global_point.size())) {
+      return false;
+    }
+    
+    std::vector<size_t> dof;
+    getPathDOF(node, dof);
+    Eigen::Vector3d const gpos(global_point[0], global_point[1], global_point[2]);
+    std::vector<jacobian_column_t> column(dof.size());
+    std::vector<Eigen::Vector3d> point_velocity(dof.size());
+    for (size_t ii(0); ii < dof.size(); ++ii) {
+      size_t const ij(dof_joint_[dof[ii]]);
+      column[ii] = read_jacobian_column(kgm_joints_[ij], dof[ii] - joint_dof_[ij]);
+      point_velocity[ii] = column[ii].head<3>() + column[ii].tail<3>().cross(gpos);
+    }
+    
+    derivatives.resize(ndof_);
+    for (size_t ik(0); ik < ndof_; ++ik) {
+      derivatives[ik].setZero(6, ndof_);
+    }
+    for (size_t ik(0); ik < dof.size(); ++ik) {
+      Eigen::Vector3d const & vk(column[ik].head<3>());
+      Eigen::Vector3d const & wk(column[ik].tail<3>());
+      Matrix & dj(derivatives[dof[ik]]);
+      for (size_t ij(0); ij < dof.size(); ++ij) {
+	Eigen::Vector3d const & vj(column[ij].head<3>());
+	Eigen::Vector3d const & wj(column[ij].tail<3>());
+	// Moving DOF k rotates and shifts column j (taken at the
+	// global origin) if k is above j on the path, or if both
+	// belong to the same joint, whose columns move along with
+	// the node. The point always moves along with the node.
+	Eigen::Vector3d dv(Eigen::Vector3d::Zero()), dw(Eigen::Vector3d::Zero());
+	if ((ik <= ij) || (dof_joint_[dof[ik]] == dof_joint_[dof[ij]])) {
+	  dv = wk.cross(vj) + vk.cross(wj);
+	  dw = wk.cross(wj);
+	}
+	dj.block<3, 1>(0, dof[ij]) = dv + dw.cross(gpos) + wj.cross(point_velocity[ik]);
+	dj.block<3, 1>(3, dof[ij]) = dw;
+      }
+    }
+    return true;
+  }
+  
+  
+  Model::NodePoint::
+  NodePoint(taoDNode const * node_,
+	    Vector const & local_point_)
+    : node(node_),
+      local_point(local_point_)
+  {
+  }
+  
+  
+  bool Model::
+  computeSparseJacobians(node_point_list_t const & points,
+			 SparseJacobian::part_t part,
+			 std::vector<SparseJacobian> & jacobians) const
+  {
+    std::vector<jacobian_column_t> column(ndof_);
+    std::vector<bool> have_column(ndof_, false);
+    jacobians.resize(points.size());
+    
+    for (size_t ip(0); ip < points.size(); ++ip) {
+      NodePoint const & np(points[ip]);
+      if (getNodeIndex(np.node) < 0) {
+	return false;
+      }
+      Transform global_frame;
+      computeGlobalFrame(np.node, np.local_point, global_frame);
+      Eigen::Vector3d const gpos(global_frame.translation());
+      
+      SparseJacobian & jacobian(jacobians[ip]);
+      getPathDOF(np.node, jacobian.dof_);
+      
+      jacobian.block_.resize((SparseJacobian::FULL == part) ? 6 : 3, jacobian.dof_.size());
+      for (size_t icol(0); icol < jacobian.dof_.size(); ++icol) {
+	size_t const dof(jacobian.dof_[icol]);
+	if ( ! have_column[dof]) {
+	  size_t const ij(dof_joint_[dof]);
+	  column[dof] = read_jacobian_column(kgm_joints_[ij], dof - joint_dof_[ij]);
+	  have_column[dof] = true;
+	}
+	jacobian.block_.col(icol) = point_jacobian_column(column[dof], gpos, part);
+      }
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeStackedJacobian(node_point_list_t const & points,
+			 SparseJacobian::part_t part,
+			 Matrix & jacobian) const
+  {
+    std::vector<SparseJacobian> jacobians;
+    if ( ! computeSparseJacobians(points, part, jacobians)) {
+      return false;
+    }
+    size_t const nrows((SparseJacobian::FULL == part) ? 6 : 3);
+    jacobian = Matrix::Zero(nrows * points.size(), ndof_);
+    for (size_t ip(0); ip < jacobians.size(); ++ip) {
+      for (size_t icol(0); icol < jacobians[ip].dof_.size(); ++icol) {
+	jacobian.block(nrows * ip, jacobians[ip].dof_[icol], nrows, 1) = jacobians[ip].block_.col(icol);
+      }
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeStackedJacobian(node_point_list_t const & points,
+			 SparseJacobian::part_t part,
+			 SparseMatrix & jacobian) const
+  {
+    std::vector<SparseJacobian> jacobians;
+    if ( ! computeSparseJacobians(points, part, jacobians)) {
+      return false;
+    }
+    size_t const nrows((SparseJacobian::FULL == part) ? 6 : 3);
+    std::vector<Eigen::Triplet<double> > triplets;
+    for (size_t ip(0); ip < jacobians.size(); ++ip) {
+      for (size_t icol(0); icol < jacobians[ip].dof_.size(); ++icol) {
+	for (size_t irow(0); irow < nrows; ++irow) {
+	  triplets.push_back(Eigen::Triplet<double>(nrows * ip + irow, jacobians[ip].dof_[icol],
+						    jacobians[ip].block_(irow, icol)));
+	}
+      }
+    }
+    jacobian.resize(nrows * points.size(), ndof_);
+    jacobian.setFromTriplets(triplets.begin(), triplets.end());
+    return true;
+  }
+  
+  
+  bool Model::
+  computeStackedJacobian(node_point_list_t const & points,
+			 SparseJacobian::part_t part,
+			 SparseRowMatrix & jacobian) const
+  {
+    SparseMatrix csc;
+    if ( ! computeStackedJacobian(points, part, csc)) {
+      return false;
+    }
+    jacobian = csc;
+    return true;
+  }
+  
+  
+  bool Model::
+  computeJacobianProduct(taoDNode const * node,
+			 Vector const & global_point,
+			 Vector const & velocity,
+			 Vector & twist) const
+  {
+    if ((getNodeIndex(node) < 0) || (ndof_ != static_cast<size_t>(velocity.size()))) {
+      return false;
+    }
+    
+    // plusEq_Jg_ddQ() multiplies the global Jacobian columns with the
+    // joint velocity, which we temporarily set along the path. The
+    // result is taken at the global origin.
+    deVector6 tao_twist;
+    tao_twist.zero();
+    for (taoDNode * nn(getHostNode(node)); ! nn->isRoot(); nn = nn->getDParent()) {
+      size_t dof(node_dof_[getNodeIndex(nn)]);
+      for (taoJoint * joint(nn->getJointList()); 0 != joint; dof += joint->getDOF(), joint = joint->getNext()) {
+	joint->setDQ(velocity.data() + dof);
+      }
+      nn->getABNode()->plusEq_Jg_ddQ(tao_twist);
+      for (taoJoint * joint(nn->getJointList()); 0 != joint; joint = joint->getNext()) {
+	joint->zeroDQ();
+      }
+    }
+    
+    Eigen::Vector3d const linear(tao_twist[0][0], tao_twist[0][1], tao_twist[0][2]);
+    Eigen::Vector3d const angular(tao_twist[1][0], tao_twist[1][1], tao_twist[1][2]);
+    twist.resize(6);
+    twist.head<3>() = linear + angular.cross(Eigen::Vector3d(global_point[0], global_point[1], global_point[2]));
+    twist.tail<3>() = angular;
+    return true;
+  }
+  
+  
+  bool Model::
+  computeJacobianTransposeProduct(taoDNode const * node,
+				  Vector const & global_point,
+				  Vector const & wrench,
+				  Vector & tau) const
+  {
+    if ((getNodeIndex(node) < 0) || (6 != wrench.size())) {
+      return false;
+    }
+    
+    // add2Tau_JgT_F() wants the wrench at the global origin.
+    deVector6 tao_wrench;
+    tao_wrench[0].set(wrench[0], wrench[1], wrench[2]);
+    Eigen::Vector3d const moment(wrench.tail<3>()
+				 + Eigen::Vector3d(global_point[0], global_point[1], global_point[2])
+				 .cross(wrench.head<3>()));
+    tao_wrench[1].set(moment.x(), moment.y(), moment.z());
+    
+    tau = Vector::Zero(ndof_);
+    for (taoDNode * nn(getHostNode(node)); ! nn->isRoot(); nn = nn->getDParent()) {
+      size_t dof(node_dof_[getNodeIndex(nn)]);
+      nn->getABNode()->add2Tau_JgT_F(tao_wrench);
+      for (taoJoint * joint(nn->getJointList()); 0 != joint; dof += joint->getDOF(), joint = joint->getNext()) {
+	joint->getTau(&tau[dof]);
+	joint->zeroTau();
+      }
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  addJacobianTransposeProduct(external_wrench_list_t const & wrenches,
+			      Vector & tau) const
+  {
+    if (ndof_ != static_cast<size_t>(tau.size())) {
+      return false;
+    }
+    
+    // Sum up the wrenches of each node, at the global origin.
+    std::vector<deVector6> node_wrench(kgm_nodes_.size());
+    for (size_t ii(0); ii < kgm_nodes_.size(); ++ii) {
+      node_wrench[ii].zero();
+    }
+    for (external_wrench_list_t::const_iterator iw(wrenches.begin()); iw != wrenches.end(); ++iw) {
+      int const index(getNodeIndex(iw->node));
+      if ((index < 0)
+	  || (3 != iw->point.size()) || (3 != iw->force.size()) || (3 != iw->moment.size())) {
+	return false;
+      }
+      Eigen::Vector3d const force(iw->force[0], iw->force[1], iw->force[2]);
+      Eigen::Vector3d const moment(Eigen::Vector3d(iw->moment[0], iw->moment[1], iw->moment[2])
+				   + Eigen::Vector3d(iw->point[0], iw->point[1], iw->point[2]).cross(force));
+      deVector6 tao_wrench;
+      tao_wrench[0].set(force.x(), force.y(), force.z());
+      tao_wrench[1].set(moment.x(), moment.y(), moment.z());
+      node_wrench[index] += tao_wrench;
+    }
+    
+    // Parents come before their children in kgm_nodes_, so one
+    // backward pass sees the complete subtree wrench of each node.
+    for (size_t ii(kgm_nodes_.size()); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      taoDNode * node(kgm_nodes_[jj]);
+      node->getABNode()->add2Tau_JgT_F(node_wrench[jj]);
+      size_t dof(node_dof_[jj]);
+      for (taoJoint * joint(node->getJointList()); 0 != joint; joint = joint->getNext()) {
+	deFloat torque[6];	// no joint has more than six DOF
+	joint->getTau(torque);
+	joint->zeroTau();
+	for (deInt kk(0); kk < joint->getDOF(); ++kk, ++dof) {
+	  tau[dof] += torque[kk];
+	}
+      }
+      int const parent(getNodeIndex(node->getDParent()));
+      if (parent >= 0) {
+	node_wrench[parent] += node_wrench[jj];
+      }
+    }
+    return true;
+  }
+  
+  
+  void Model::
+  getPathDOF(taoDNode const * node, std::vector<size_t> & dof) const
+  {
+    dof.clear();
+    for (taoDNode * nn(getHostNode(node)); ! nn->isRoot(); nn = nn->getDParent()) {
+      int const index(getNodeIndex(nn));
+      for (size_t ii(node_ndof_[index]); ii > 0; --ii) {
+	dof.push_back(node_dof_[index] + ii - 1);
+      }
+    }
+    std::reverse(dof.begin(), dof.end());
+  }
+  
+  
+  int Model::
+  getNodeIndex(taoDNode const * node) const
+  {
+    node_index_map_t::const_iterator const in(kgm_index_.find(node));
+    if (kgm_index_.end() == in) {
+      return -1;
+    }
+    return in->second;
+  }
+  
+  
+  taoDNode * Model::
+  getHostNode(taoDNode const * node) const
+  {
+    int const index(getNodeIndex(node));
+    if (index < 0) {
+      return 0;
+    }
+    return kgm_nodes_[index];
+  }
+  
+  
+  taoDNode * Model::
+  findNodeByID(int id) const
+  {
+    for (nodeVector_t::const_iterator in(kgm_nodes_.begin()); in != kgm_nodes_.end(); ++in) {
+      if (id == (*in)->getID()) {
+	return *in;
+      }
+    }
+    for (nodeVector_t::const_iterator in(kgm_fused_.begin()); in != kgm_fused_.end(); ++in) {
       if (id == (*in)->getID()) {
 	return *in;
       }
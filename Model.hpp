@@ -32,11 +32,15 @@
 #define MINITAO_MODEL_HPP
 
 #include "State.hpp"
+#include "SparseJacobian.hpp"
+#include "spatial.hpp"
 #include "tao_util.hpp"
 #include "wrap_eigen.hpp"
+#include <Eigen/Cholesky>
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 
 
 namespace minitao {
@@ -71,9 +75,10 @@ namespace minitao {
 	representation, which forces us to distribute the state over
 	its nodes before computing the model.
 	
-	\pre The NDOF of the state has to match the NDOF of the
-	model. No check is performed in this method, it can crash your
-	program if you're not careful.
+	\pre The position of the state has to have getNPositions()
+	entries, and its velocity getNDOF() entries. No check is
+	performed in this method, it can crash your program if you're
+	not careful.
     */
     void setState(State const & state);
     
@@ -91,9 +96,33 @@ namespace minitao {
 	- the root node is NOT included in this count.
 	- in principle, each node can have any number of joints, and
 	  each joint can have any number of degrees of freedom, which
-	  is why getNJoints() and getNDOF() might come in handy, too. */
+	  is why getNJoints() and getNDOF() might come in handy, too.
+	- nodes without joints are merged into their parent when the
+	  model is constructed, and do not count, see
+	  getNFusedNodes(). */
     size_t getNNodes() const;
     
+    /** Retrieve the number of KGM nodes that were merged into their
+	parent at construction because they have no joints, i.e. they
+	are rigidly attached to it. Their mass properties are added to
+	the parent, which thus represents the whole rigid body, and
+	their children become children of the parent.
+	
+	Merged nodes remain valid arguments for all methods that take a
+	node. They keep their offset from the parent, so their global
+	frame is available as before, and Jacobians etc are computed
+	via the parent. The exception are jointless children of the
+	root: they cannot move, so their mass is dropped, and only
+	getGlobalFrame(), computeGlobalFrame(), and findNodeByID() work
+	for them. */
+    size_t getNFusedNodes() const;
+    
+    /** \return The KGM node with the given index, which ranges from
+	0 to getNNodes()-1, or NULL if the index is out of range.
+	Parents come before their children. Fused nodes (see
+	getNFusedNodes()) cannot be retrieved this way. */
+    taoDNode * getNode(size_t index) const;
+    
     /** Compute or retrieve the cached number of joints in the
 	robot. Note that each joint can have any number of degrees of
 	freedom, which is why getNDOF() might come in handy, too. */
@@ -105,6 +134,47 @@ namespace minitao {
 	else than getNJoints(). */
     size_t getNDOF() const;
     
+    /** Retrieve the number of position coordinates of the robot. This
+	is larger than getNDOF() if there are joints which store their
+	orientation as a quaternion, e.g. spherical joints take four
+	position coordinates and free-flyer joints seven (translation
+	followed by the quaternion x, y, z, w). The DOF of a joint are
+	numbered consecutively, in the order of the joints in the
+	tree, and likewise for its position coordinates. */
+    size_t getNPositions() const;
+    
+    /** Create a model of the same robot in which the joints of the
+	given nodes are locked at their values in \c position, which
+	has getNPositions() entries (the entries of the other joints
+	are ignored). The locked nodes are merged with their parent
+	into composite rigid bodies (see getNFusedNodes()), so all
+	quantities of the new model are sized to the remaining DOF,
+	which keep their order. Nodes are not shared between the
+	models, use findNodeByID() to look up the corresponding
+	node. Disabled gravity compensation carries over.
+	
+	Both models are independent, so a controller can keep one for
+	the whole robot and one for each task, and switch between them
+	at the cost of reduceState().
+	
+	\return A new model that the caller has to delete, or NULL if
+	one of the nodes is not in the KGM tree (or has been fused into
+	its parent), \c position has the wrong size, or a joint type
+	is not supported. */
+    Model * createReducedModel(std::vector<taoDNode const *> const & locked_nodes,
+			       std::vector<double> const & position) const;
+    
+    /** Index in the original model of each DOF of a model created by
+	createReducedModel(), or 0 to getNDOF()-1 for any other
+	model. */
+    inline std::vector<size_t> const & getActiveDOF() const { return active_dof_; }
+    
+    /** Extract the entries that belong to the DOF of this model from
+	the state of the original model (see createReducedModel()).
+	The velocity and force are only extracted if they are not
+	empty. No size checks are performed. */
+    void reduceState(State const & full_state, State & state) const;
+    
     /** Deprecated TAO node access method which ends up doing a linear
 	(order NDOF) search over the KGM tree.
 	
@@ -112,7 +182,8 @@ namespace minitao {
 	indexing branches of your robot...
 	
 	\return The first node that matches the ID, or NULL if the id
-	was not found in the KGM tree.
+	was not found in the KGM tree or among the nodes that were
+	merged into their parent.
     */
     taoDNode * findNodeByID(int id) const;
     
@@ -181,8 +252,7 @@ namespace minitao {
     /** Compute the Jacobian (J_v over J_omega) for a given node, at a
 	point expressed wrt to the global frame.
 	
-	\todo Implement support for more than one joint per node, and
-	more than one DOF per joint.
+	\todo Implement support for more than one joint per node.
 	
 	\return True on success. There are two possible failures: an
 	invalid node, or an unsupported joint type. If you got the
@@ -199,6 +269,150 @@ namespace minitao {
 				Matrix & jacobian) const
     { return computeJacobian(node, global_point[0], global_point[1], global_point[2], jacobian); }
     
+    /** Compute the Jacobian for a given node, at a point expressed
+	wrt the global frame, in the compact form that only contains
+	the columns of the ancestors of the node. This only visits
+	the path from the node to the root, instead of all NDOF
+	joints. Use the \c part argument to get only the linear or
+	only the angular rows.
+	
+	\return True on success. The only possible failure is a node
+	that is not in the KGM tree. */
+    bool computeSparseJacobian(taoDNode const * node,
+			       Vector const & global_point,
+			       SparseJacobian::part_t part,
+			       SparseJacobian & jacobian) const;
+    
+    /** Compute the derivatives of the Jacobian (J_v over J_omega) of
+	a point attached to a node with respect to the joint
+	positions, i.e. the kinematic Hessian. \c derivatives[k] is
+	the 6 x NDOF partial derivative of the Jacobian with respect
+	to DOF k, with the point moving along with the node. As in
+	computeInverseDynamicsDerivatives(), the displacements of
+	spherical and free joints are expressed like their velocity,
+	in node coordinates.
+	
+	This reuses the global joint columns that computeJacobian()
+	reads, so it does not need any kinematics passes beyond
+	updateKinematics(), and the cost is quadratic in the number of
+	DOF between the node and the root. Only the matrices and
+	columns of those DOF are nonzero. Summing \c derivatives[k]
+	times the joint velocity k gives the time derivative of the
+	Jacobian.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the node is not in
+	the KGM tree, or that the point does not have three entries. */
+    bool computeJacobianDerivatives(taoDNode const * node,
+				    Vector const & global_point,
+				    std::vector<Matrix> & derivatives) const;
+    
+    /** A point attached to a node, expressed wrt the node origin,
+	for use with the bulk Jacobian methods. */
+    struct NodePoint {
+      NodePoint(taoDNode const * node,
+		Vector const & local_point);
+      
+      taoDNode const * node;
+      Vector local_point;
+    };
+    
+    typedef std::vector<NodePoint> node_point_list_t;
+    
+    /** Compute the sparse Jacobians of many points at once. Each
+	joint column is read only once, no matter how many points
+	share it, and only the columns of joints that are ancestors of
+	at least one of the nodes are read at all.
+	
+	\return True on success. The only possible failure is a node
+	that is not in the KGM tree. */
+    bool computeSparseJacobians(node_point_list_t const & points,
+				SparseJacobian::part_t part,
+				std::vector<SparseJacobian> & jacobians) const;
+    
+    /** Stack the Jacobians of many points, in the order of the list,
+	into a dense matrix with NDOF columns. The rows of each point
+	are selected with \c part. Columns of joints that are not
+	ancestors of a point are zero in its rows.
+	
+	\return True on success, see computeSparseJacobians(). */
+    bool computeStackedJacobian(node_point_list_t const & points,
+				SparseJacobian::part_t part,
+				Matrix & jacobian) const;
+    
+    /** Same as the dense computeStackedJacobian(), but produces a
+	compressed sparse column matrix which only contains the
+	ancestor columns of each point. */
+    bool computeStackedJacobian(node_point_list_t const & points,
+				SparseJacobian::part_t part,
+				SparseMatrix & jacobian) const;
+    
+    /** Same as the dense computeStackedJacobian(), but produces a
+	compressed sparse row matrix which only contains the ancestor
+	columns of each point. */
+    bool computeStackedJacobian(node_point_list_t const & points,
+				SparseJacobian::part_t part,
+				SparseRowMatrix & jacobian) const;
+    
+    /** Compute the product of the time derivative of the Jacobian of
+	a point attached to a node with the joint velocity given to
+	setState(), i.e. the acceleration of the point (linear over
+	angular, global coordinates) that is due to the velocity
+	alone. This uses one velocity sweep over the KGM tree followed
+	by TAO's bias acceleration recursion
+	(taoABDynamics::biasAccelerationOut()), so the cost is linear
+	in the number of nodes.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that no state has been
+	set, or that the node is not in the KGM tree. */
+    bool computeJdotQdot(taoDNode const * node,
+			 Vector const & global_point,
+			 Vector & jdot_qdot) const;
+    
+    /** Bulk version of computeJdotQdot() that shares the recursion
+	among all points and stacks the results in the order of the
+	list, with the rows of each point selected by \c part as in
+	computeStackedJacobian().
+	
+	\return True on success, see the single-point version for the
+	causes of failure. */
+    bool computeJdotQdot(node_point_list_t const & points,
+			 SparseJacobian::part_t part,
+			 Vector & jdot_qdot) const;
+    
+    /** Compute the center of mass of the whole tree, in global
+	coordinates.
+	
+	\return True on success. The only possibility of receiving
+	false is if the tree has no mass. */
+    bool computeCenterOfMass(Vector & com) const;
+    
+    /** Compute the center of mass and its 3xNDOF Jacobian, in
+	global coordinates. The Jacobian comes from the composite
+	rigid body inertias accumulated in one pass from the leaves to
+	the root, so the cost is linear in the number of nodes.
+	
+	\return True on success. Failure means that the tree has no
+	mass, or that a node has an unsupported joint type. */
+    bool computeCenterOfMass(Vector & com, Matrix & jacobian) const;
+    
+    /** Compute the 6xNDOF centroidal momentum matrix and the rate of
+	change of centroidal momentum for the velocity given to
+	setState() at zero joint acceleration, such that the momentum
+	is \c momentum_matrix times the joint velocity and its rate is
+	\c momentum_matrix times the joint acceleration plus \c
+	momentum_bias. Linear momentum comes first, followed by the
+	angular momentum about the center of mass, both in global
+	coordinates. The cost is linear in the number of nodes.
+	
+	\return True on success. Failure means that no state has been
+	set, or see computeCenterOfMass(). */
+    bool computeCentroidalMomentum(Matrix & momentum_matrix,
+				   Vector & momentum_bias) const;
+    
     //////////////////////////////////////////////////
     // dynamics facet
     
@@ -206,7 +420,36 @@ namespace minitao {
 	computeMassInertia(), and computeInverseMassInertia(). */
     void updateDynamics();
     
-    /** Compute the gravity joint-torque vector. */
+    /** Replace the mass properties of a link, e.g. when the gripper
+	picks up an object, without rebuilding the TAO trees. The
+	center of mass \c com and the 3x3 \c inertia about it are
+	expressed in the node frame. They describe the given link
+	alone: if it has been merged into its parent (see
+	getNFusedNodes()), or if other links have been merged into it,
+	the composite rigid body gets updated accordingly.
+	
+	Kinematic quantities remain valid, but the dynamic ones are
+	discarded until the next updateDynamics() (or the
+	corresponding computeFoo()). Nothing gets allocated.
+	
+	\return True on success. Failure means that the node is not in
+	the KGM tree, is attached to the root without joints, or that
+	the arguments have the wrong size or a negative mass. */
+    bool setLinkInertia(taoDNode const * node,
+			double mass,
+			Vector const & com,
+			Matrix const & inertia);
+    
+    /** Compute the gravity basis (see getGravityBasis()) and the
+	gravity joint-torque vector for earth gravity. This
+	accumulates the mass and center of mass of each subtree in one
+	pass, which is much cheaper than a full inverse dynamics sweep.
+	Trees with nodes that do not have exactly one revolute,
+	prismatic, spherical, or free joint fall back to inverse
+	dynamics, which only computes the earth gravity torque. The
+	basis then gets computed on the first call to
+	getGravityBasis() or getGravity(g_vector, gravity), with three
+	more inverse dynamics sweeps at the kinematics of that call. */
     void computeGravity();
     
     /** Disable (or enable) gravity compensation for a given DOF
@@ -227,6 +470,28 @@ namespace minitao {
 	called by updateDynamics(), which gets called by update(). */
     bool getGravity(Vector & gravity) const;
     
+    /** Retrieve the gravity joint-torque vector for an arbitrary
+	gravity vector, given in global coordinates. To account for a
+	base that accelerates with a linear acceleration \c a (but does
+	not rotate), pass the gravity vector minus \c a. The torque is
+	linear in the gravity vector, so this is just a product with
+	the gravity basis and can be called many times per
+	configuration. Disabled gravity compensation entries are set
+	to zero.
+	
+	\return True on success. Failure means that you never called
+	computeGravity(), or that \c g_vector does not have three
+	entries. */
+    bool getGravity(Vector const & g_vector, Vector & gravity) const;
+    
+    /** Retrieve the NDOFx3 gravity basis, whose columns are the
+	gravity joint-torque vectors for unit gravity along the
+	global X, Y, and Z axes. It is computed by computeGravity().
+	
+	\return True on success. The only possibility of receiving
+	false is if you never called computeGravity(). */
+    bool getGravityBasis(Matrix & basis) const;
+    
     /** Compute the Coriolis and contrifugal joint-torque vector. If
 	you set cc_root=NULL in the constructor, then this is a
 	no-op. */
@@ -241,6 +506,35 @@ namespace minitao {
 	update(). */
     bool getCoriolisCentrifugal(Vector & coriolis_centrifugal) const;
     
+    /** Compute the Coriolis matrix C, such that C times the joint
+	velocity is the Coriolis and centrifugal joint-torque vector
+	and the time derivative of the mass-inertia matrix minus 2 * C
+	is skew-symmetric. This uses one recursive sweep over the KGM
+	tree with the velocity given to setState(), with a cost that
+	is quadratic in the number of DOF. It is not called by
+	updateDynamics(). */
+    void computeCoriolisMatrix();
+    
+    /** Retrieve the Coriolis matrix.
+	
+	\return True on success. There are two possibilities of
+	receiving false: (i) you never called computeCoriolisMatrix(),
+	or (ii) it failed because no state was set or because a node
+	has an unsupported joint type. */
+    bool getCoriolisMatrix(Matrix & coriolis) const;
+    
+    /** Compute the kinetic energy of the links for the velocity
+	given to setState(), using TAO's velocity traversal of the KGM
+	tree. Rotor inertias of the joints are not included.
+	
+	\return True on success. The only possibility of receiving
+	false is if no state has been set. */
+    bool computeKineticEnergy(double & energy) const;
+    
+    /** \return The potential energy due to earth gravity, with zero
+	at the height of the global origin. */
+    double computePotentialEnergy() const;
+    
     /** Compute the joint-space mass-inertia matrix, a.k.a. the
 	kinetic energy matrix. */
     void computeMassInertia();
@@ -263,6 +557,412 @@ namespace minitao {
 	called by updateDynamics(), which gets called by update(). */
     bool getInverseMassInertia(Matrix & inverse_mass_inertia) const;
     
+    /** Compute the product of the mass-inertia matrix with a
+	vector, using one zero-velocity zero-gravity inverse dynamics
+	sweep over the KGM tree. Use this instead of getMassInertia()
+	if you only need products, e.g. in iterative solvers. The KGM
+	tree serves as scratch space and is left at rest, so this
+	does not change the observable state of the model.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. The only possible failure is a
+	vector that does not have NDOF entries. */
+    bool computeMassInertiaProduct(Vector const & xx,
+				   Vector & result) const;
+    
+    /** Compute the product of the inverse mass-inertia matrix with
+	a vector, using one zero-velocity zero-gravity forward
+	dynamics sweep over the KGM tree, which like
+	computeMassInertiaProduct() is left at rest.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. The only possible failure is a
+	vector that does not have NDOF entries. */
+    bool computeInverseMassInertiaProduct(Vector const & yy,
+					  Vector & result) const;
+    
+    /** Multi-column version of computeMassInertiaProduct(). The
+	motion subspaces and spatial inertias are computed once and
+	shared by all columns.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the matrix does
+	not have NDOF rows, or that a node has an unsupported joint
+	type. */
+    bool computeMassInertiaProduct(Matrix const & xx,
+				   Matrix & result) const;
+    
+    /** Multi-column version of computeInverseMassInertiaProduct().
+	The articulated inertias are factored once and shared by all
+	columns, which only need the bias force and acceleration
+	sweeps.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the matrix does
+	not have NDOF rows, or that a node has an unsupported joint
+	type. */
+    bool computeInverseMassInertiaProduct(Matrix const & yy,
+					  Matrix & result) const;
+    
+    /** An external force and moment acting on a node, for use with
+	computeInverseDynamics(). The point of application, the
+	force, and the moment are expressed in global coordinates. */
+    struct ExternalWrench {
+      ExternalWrench(taoDNode * node,
+		     Vector const & point,
+		     Vector const & force,
+		     Vector const & moment);
+      
+      taoDNode * node;
+      Vector point;
+      Vector force;
+      Vector moment;
+    };
+    
+    typedef std::vector<ExternalWrench> external_wrench_list_t;
+    
+    /** Compute the joint torque required to produce the given joint
+	acceleration at the state given to setState(), including
+	Coriolis-centrifugal effects and earth gravity, in a single
+	recursive Newton-Euler sweep over the KGM tree. This is
+	cheaper than combining getGravity(),
+	getCoriolisCentrifugal(), and getMassInertia(), and it works
+	even if you set cc_root=NULL in the constructor.
+	
+	External wrenches are those exerted by the environment onto
+	the robot, their effect gets subtracted from the torque. The
+	gravity compensation flags of disableGravityCompensation() are
+	ignored here.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the acceleration
+	does not have NDOF entries, that no state has been set, or
+	that a wrench refers to a NULL node or does not have three
+	entries in its point, force, or moment. */
+    bool computeInverseDynamics(Vector const & acceleration,
+				external_wrench_list_t const & external_wrenches,
+				Vector & tau);
+    
+    /** Convenience method for computeInverseDynamics() without
+	external wrenches. */
+    bool computeInverseDynamics(Vector const & acceleration,
+				Vector & tau);
+    
+    /** Compute the joint acceleration that results from applying
+	the given joint torque at the given state, including
+	Coriolis-centrifugal effects and earth gravity. This runs one
+	articulated-body forward dynamics sweep over the KGM tree,
+	which is about NDOF times cheaper than going through
+	getInverseMassInertia().
+	
+	The state does not have to be the one passed to setState().
+	The KGM tree is put back into the state from setState()
+	afterwards, so frames, Jacobians, and the cached dynamic
+	quantities are not disturbed.
+	
+	\return True on success. Failure means that the state or the
+	torque does not have NDOF entries. */
+    bool computeForwardDynamics(State const & state,
+				Vector const & tau,
+				Vector & acceleration);
+    
+    /** Solve a mixed dynamics problem in which some joints have a
+	given acceleration (e.g. position-controlled joints) and the
+	others a given torque, at the state given to setState() and
+	including Coriolis-centrifugal effects and earth gravity. Both
+	vectors have NDOF entries: where \c acceleration_given is
+	true, the acceleration is an input and the torque gets
+	computed, elsewhere it is the other way around. This runs one
+	hybrid articulated-body sweep over the KGM tree, so the cost
+	is linear in the number of nodes.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that one of the vectors
+	does not have NDOF entries, that no state has been set, or
+	that a node has an unsupported joint type. */
+    bool computeHybridDynamics(std::vector<bool> const & acceleration_given,
+			       Vector & acceleration,
+			       Vector & tau) const;
+    
+    /** Compute the partial derivatives of the inverse dynamics
+	torque with respect to joint position and joint velocity, at
+	the state given to setState() and the given joint
+	acceleration. Earth gravity is included. This uses recursive
+	passes over the tree whose cost is a small multiple of one
+	inverse dynamics sweep, instead of finite differences.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the acceleration
+	does not have NDOF entries, that no state has been set, or
+	that a node has an unsupported joint type. */
+    bool computeInverseDynamicsDerivatives(Vector const & acceleration,
+					   Matrix & dtau_dposition,
+					   Matrix & dtau_dvelocity) const;
+    
+    /** Compute the partial derivatives of the forward dynamics joint
+	acceleration with respect to joint position and joint
+	velocity, at the state given to setState() and the given
+	joint torque. The derivative with respect to the torque is the
+	inverse mass-inertia matrix.
+	
+	The inverse dynamics derivatives get multiplied with the
+	inverse mass-inertia matrix using the articulated-body factors
+	of computeInverseMassInertiaProduct(), so the cost is quadratic
+	in NDOF and no dense matrix gets factored.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success, see
+	computeInverseDynamicsDerivatives() for the causes of
+	failure. */
+    bool computeForwardDynamicsDerivatives(Vector const & tau,
+					   Matrix & dacc_dposition,
+					   Matrix & dacc_dvelocity) const;
+    
+    /** Compute the inverse dynamics regressor, i.e. the NDOF x
+	(10 * getNNodes()) matrix Y such that Y times the vector from
+	getInertialParameters() is the joint torque that
+	computeInverseDynamics() returns for the given joint
+	acceleration at the state given to setState(), including
+	Coriolis-centrifugal effects and earth gravity. The inverse
+	dynamics are linear in the inertial parameters, so this can be
+	used to identify them from measured torques (see
+	ParameterEstimator), or to evaluate the torque for other
+	parameters with a matrix product. Y is computed in one
+	recursive pass over the KGM tree.
+	
+	There are ten parameters per node, in the order of getNode():
+	the mass m, the first moment m * com, and the inertia about
+	the node origin (not about the center of mass) in the order
+	xx, xy, xz, yy, yz, zz. All of them are expressed in the node
+	frame. Links that have been merged into their parent (see
+	getNFusedNodes()) are part of its parameters. Joint inertias
+	are not link parameters, so their torque is not included.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the acceleration
+	does not have NDOF entries, that no state has been set, or
+	that a node has an unsupported joint type. */
+    bool computeRegressor(Vector const & acceleration,
+			  Matrix & regressor) const;
+    
+    /** Retrieve the current inertial parameters of the KGM nodes, in
+	the layout used by computeRegressor(). */
+    void getInertialParameters(Vector & parameters) const;
+    
+    /** Evaluate the gravity torque, the Coriolis-centrifugal torque,
+	and the mass-inertia matrix for an ensemble of K sets of
+	inertial parameters at the state given to setState(), e.g. for
+	robust control with perturbed payloads. Each column of \c
+	parameters is one set in the layout of
+	getInertialParameters(), and column k of \c gravity and \c
+	coriolis_centrifugal as well as \c mass_inertia[k] are the
+	corresponding results. The tree itself is not modified.
+	
+	The motion subspaces and regressors (see computeRegressor())
+	are computed once from the current frames, after which the
+	whole ensemble takes one matrix product per quantity. The
+	gravity compensation flags of disableGravityCompensation() are
+	taken into account, and the joint inertias are added to the
+	diagonal of the mass-inertia matrices like in
+	computeMassInertia().
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that \c parameters does
+	not have 10 * getNNodes() rows, that no state has been set, or
+	that a node has an unsupported joint type. */
+    bool computeEnsembleDynamics(Matrix const & parameters,
+				 Matrix & gravity,
+				 Matrix & coriolis_centrifugal,
+				 std::vector<Matrix> & mass_inertia) const;
+    
+    /** Compute the operational-space inertia matrix (often called
+	Lambda) of a point attached to a node. The result is the 6x6
+	matrix (linear part first, global coordinates) that maps the
+	acceleration of that point to the force and moment acting on
+	it, i.e. the inverse of J*Ainv*J^T where J is the Jacobian
+	returned by computeJacobian().
+	
+	Instead of going through the mass-inertia matrix, this uses
+	the O(NDOF) recursion for the inverse operational-space
+	inertia of all nodes that is part of TAO's articulated-body
+	algorithm. The Cholesky factor at the node origin is cached
+	until the next setState() or updateKinematics(), so further
+	points on the same node and computeOpSpaceBias() only need a
+	6x6 change of reference point.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the node is NULL,
+	or that the inverse operational-space inertia is singular
+	because the node has fewer than six degrees of freedom above
+	it or the robot is in a singular configuration. */
+    bool computeOpSpaceInertia(taoDNode const * node,
+			       Vector const & global_point,
+			       Matrix & lambda);
+    
+    /** Compute the operational-space Coriolis-centrifugal and
+	gravity forces that go along with computeOpSpaceInertia(),
+	such that the force Lambda * xdd + coriolis_centrifugal +
+	gravity at the point, mapped to joint torques with J^T,
+	produces the point acceleration xdd. Both are 6-vectors in
+	global coordinates, linear part first. They are computed from
+	the free accelerations of one articulated-body sweep with the
+	velocity given to setState() and one with earth gravity. The
+	gravity compensation flags of disableGravityCompensation() are
+	ignored here.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that no state has been
+	set, or any of the reasons listed for
+	computeOpSpaceInertia(). */
+    bool computeOpSpaceBias(taoDNode const * node,
+			    Vector const & global_point,
+			    Vector & coriolis_centrifugal,
+			    Vector & gravity);
+    
+    /** A point contact on a node, for use with
+	computeDelassusMatrix(). The point is expressed in global
+	coordinates. */
+    struct Contact {
+      Contact(taoDNode const * node,
+	      Vector const & point);
+      
+      taoDNode const * node;
+      Vector point;
+    };
+    
+    typedef std::vector<Contact> contact_list_t;
+    
+    /** Compute the contact-space inverse inertia (also known as the
+	Delassus matrix) J*Ainv*J^T for a set of point contacts,
+	where J stacks the linear parts of the contact Jacobians. The
+	result has three rows and columns per contact, in the order
+	of the list and in global coordinates, and includes the
+	cross-coupling between all contacts. It maps contact forces to
+	the resulting contact point accelerations.
+	
+	This is an extension of the recursion behind
+	computeOpSpaceInertia(): the contact force maps are
+	propagated towards the root through the articulated-body
+	inertias in one sweep, without building the mass-inertia
+	matrix or any Jacobian.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that a contact refers
+	to a node that is not in the KGM tree, or that a node has an
+	unsupported joint type. */
+    bool computeDelassusMatrix(contact_list_t const & contacts,
+			       Matrix & delassus) const;
+    
+    /** A desired acceleration of a point attached to a node, for use
+	with computeOpSpaceInverseDynamics(). The point and the
+	acceleration are expressed in global coordinates. The
+	acceleration has either three entries (linear only) or six
+	(linear part first, then angular). */
+    struct EndEffector {
+      EndEffector(taoDNode const * node,
+		  Vector const & point,
+		  Vector const & acceleration);
+      
+      taoDNode const * node;
+      Vector point;
+      Vector acceleration;
+    };
+    
+    typedef std::vector<EndEffector> end_effector_list_t;
+    
+    /** Compute the joint torque that produces the desired
+	accelerations of several end-effectors at once, at the state
+	given to setState() and with earth gravity. The task forces
+	are computed with the stacked operational-space inertia of
+	all end-effectors, including their coupling through shared
+	ancestors, and are applied on top of the given null-space
+	torque (which can be zero), i.e. tau = tau_null + J^T * F.
+	This is the multi-node version of
+	taoABDynamics::opSpaceInvDynamics().
+	
+	It takes one articulated-body sweep for the accelerations due
+	to tau_null, one sweep over the ancestors of the end-effectors
+	for the stacked inverse inertia as in
+	computeDelassusMatrix(), and one for mapping the forces to
+	joint torques, so each joint is visited once per pass no
+	matter how many end-effectors share it.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that no state has been
+	set, that tau_null does not have NDOF entries, that an
+	end-effector refers to a node that is not in the KGM tree or
+	has an acceleration with neither three nor six entries, that a
+	node has an unsupported joint type, or that the stacked
+	operational-space inertia is singular. The latter happens
+	when the tasks ask for more than the robot can do. */
+    bool computeOpSpaceInverseDynamics(end_effector_list_t const & end_effectors,
+				       Vector const & tau_null,
+				       Vector & tau);
+    
+    /** Compute the product of the Jacobian of a point attached to a
+	node with a joint-space vector, e.g. the twist (linear velocity
+	over angular velocity, in global coordinates) of the point for
+	a given joint velocity. This walks the ancestors of the node
+	using taoABNode::plusEq_Jg_ddQ() and never builds the
+	Jacobian, so joints that are not ancestors of the node are
+	skipped and their entries in the vector are ignored.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the node is not in
+	the KGM tree, or that the vector does not have NDOF entries. */
+    bool computeJacobianProduct(taoDNode const * node,
+				Vector const & global_point,
+				Vector const & velocity,
+				Vector & twist) const;
+    
+    /** Compute the joint torque J^T * wrench for a wrench (force over
+	moment, in global coordinates) acting on a point attached to a
+	node. This walks the ancestors of the node using
+	taoABNode::add2Tau_JgT_F() and never builds the Jacobian. The
+	entries of joints that are not ancestors of the node are
+	zero.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that the node is not in
+	the KGM tree, or that the wrench does not have six entries. */
+    bool computeJacobianTransposeProduct(taoDNode const * node,
+					 Vector const & global_point,
+					 Vector const & wrench,
+					 Vector & tau) const;
+    
+    /** Accumulating version of computeJacobianTransposeProduct() for
+	several wrenches on different nodes: adds the sum of J^T *
+	wrench over the whole list to tau. The wrenches are first
+	accumulated into one spatial force per node and then mapped
+	to joint torques in a single sweep from the leaves to the
+	root, so shared ancestors are visited only once.
+	
+	\pre updateKinematics() has been called for the current state.
+	
+	\return True on success. Failure means that tau does not have
+	NDOF entries, or that a wrench refers to a node that is not in
+	the KGM tree or does not have three entries in its point,
+	force, or moment. In the latter cases, tau is left
+	untouched. */
+    bool addJacobianTransposeProduct(external_wrench_list_t const & wrenches,
+				     Vector & tau) const;
+    
     
     /** For debugging only, access to the
 	kinematics-gravity-mass-inertia tree. */
@@ -275,23 +975,146 @@ namespace minitao {
     
     
   private:
+    /** Fill g_basis_ with inverse dynamics, unless the gravity
+	kernel of computeGravity() has already done so. */
+    void computeGravityBasis() const;
+    
     typedef std::set<size_t> dof_set_t;
     dof_set_t gravity_disabled_;
     
     std::size_t ndof_;
+    std::size_t npos_;
     taoDNode * kgm_root_;
     nodeVector_t kgm_nodes_;
     jointVector_t kgm_joints_;
     
+    /** Nodes without joints that were merged into their parent. They
+	are not part of the tree anymore, so we have to delete them
+	ourselves. */
+    nodeVector_t kgm_fused_;
+    
+    /** Index of the first degree of freedom, and of the first
+	position coordinate, of each joint in kgm_joints_. The same
+	offsets apply to cc_joints_. */
+    std::vector<size_t> joint_dof_;
+    std::vector<size_t> joint_position_;
+    
+    /** Index of the joint in kgm_joints_ that each degree of freedom
+	belongs to. */
+    std::vector<size_t> dof_joint_;
+    
+    /** Index of each DOF and position coordinate in the original
+	model, see createReducedModel(). */
+    std::vector<size_t> active_dof_;
+    std::vector<size_t> active_position_;
+    
+    /** Index of the first degree of freedom of each node in
+	kgm_nodes_, and the number of degrees of freedom of its
+	joints. */
+    std::vector<size_t> node_dof_;
+    std::vector<size_t> node_ndof_;
+    
+    /** Index of each KGM node in kgm_nodes_. Use node_dof_ to get to
+	its degrees of freedom. Fused nodes map to the index of the
+	node that they were merged into. */
+    typedef std::map<taoDNode const *, size_t> node_index_map_t;
+    node_index_map_t kgm_index_;
+    
+    /** Index of the parent of each KGM node, or -1 for children of
+	the root. */
+    std::vector<int> kgm_parent_;
+    
     taoDNode * cc_root_;
     nodeVector_t cc_nodes_;
     jointVector_t cc_joints_;
+    nodeVector_t cc_fused_;
+    
+    /** Node of the CC tree for each KGM node, fused ones included.
+	The nodes correspond by index, the fused ones by ID. */
+    typedef std::map<taoDNode const *, taoDNode *> node_map_t;
+    node_map_t cc_node_;
     
     State state_;
+    
+    /** Whether g_torque_ and g_basis_ hold the gravity for the
+	current state and mass properties. They keep their storage
+	when invalidated. The basis is only valid when g_basis_valid_
+	is set as well: in the inverse dynamics fallback of
+	computeGravity(), it gets filled on demand by
+	computeGravityBasis(). */
+    bool gravity_valid_;
+    mutable bool g_basis_valid_;
     std::vector<double> g_torque_;
+    mutable Matrix g_basis_;
+    gravity_scratch_s gravity_scratch_;
     std::vector<double> cc_torque_;
+    std::vector<double> c_matrix_;
     std::vector<double> a_upper_triangular_;
     std::vector<double> ainv_upper_triangular_;
+    
+    /** Cholesky factor of the inverse operational-space inertia at
+	a node origin, in global coordinates. Entries are marked
+	invalid instead of being erased, so that they keep their
+	storage from one state to the next. */
+    struct opspace_factor_s {
+      opspace_factor_s(): valid(false) {}
+      Eigen::LLT<Matrix> llt;
+      bool valid;
+    };
+    typedef std::map<taoDNode const *, opspace_factor_s> opspace_factor_map_t;
+    opspace_factor_map_t opspace_factor_;
+    bool opspace_omega_valid_;
+    
+    /** \return The cached factor for the node, computing it if
+	necessary, or NULL if it is singular. */
+    Eigen::LLT<Matrix> const * getOpSpaceFactor(taoDNode const * node);
+    
+    /** Mark all cached factors and the TAO Omega matrices as out of
+	date. */
+    void invalidateOpSpaceFactors();
+    
+    /** Run one forward dynamics sweep over the KGM tree, optionally
+	with the velocity of state_, earth gravity, and a joint
+	torque. Call getSweepAcceleration() to retrieve the results,
+	and then resetSweep() to put the KGM tree back to rest. */
+    void sweepForwardDynamics(bool with_velocity,
+			      bool with_gravity,
+			      Vector const * tau);
+    
+    /** Retrieve the classical acceleration of a point attached to a
+	node after sweepForwardDynamics(), in global coordinates and
+	linear part first. */
+    void getSweepAcceleration(taoDNode const * node,
+			      Eigen::Vector3d const & global_point,
+			      Vector & acceleration) const;
+    
+    void resetSweep() const;
+    
+    /** Run one velocity sweep over the KGM tree with the velocity of
+	state_ and then TAO's bias acceleration recursion. Call
+	resetSweep() after retrieving the results with
+	getSweepBiasAcceleration(). */
+    void sweepBiasAcceleration() const;
+    
+    /** Retrieve Jdot * qdot of a point attached to a node after
+	sweepBiasAcceleration(), in global coordinates and linear part
+	first. */
+    void getSweepBiasAcceleration(taoDNode const * node,
+				  Eigen::Vector3d const & global_point,
+				  Vector & jdot_qdot) const;
+    
+    /** \return The index of a KGM node in kgm_nodes_, or -1 if the
+	node is not in the KGM tree. */
+    int getNodeIndex(taoDNode const * node) const;
+    
+    /** \return The node in kgm_nodes_ that carries the mass of the
+	given node, i.e. the node itself unless it has been fused into
+	its parent, or NULL if it is not in the KGM tree. */
+    taoDNode * getHostNode(taoDNode const * node) const;
+    
+    /** Fill dof with the indices of the degrees of freedom between a
+	KGM node and the root, in ascending order. */
+    void getPathDOF(taoDNode const * node, std::vector<size_t> & dof) const;
   };
   
 }
@@ -0,0 +1,111 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file ParameterEstimator.cpp
+*/
+
+#include "ParameterEstimator.hpp"
+#include "Model.hpp"
+#include <Eigen/Cholesky>
+
+
+namespace minitao {
+  
+  
+  ParameterEstimator::
+  ParameterEstimator(Model * model)
+    : model_(model)
+  {
+    reset();
+  }
+  
+  
+  void ParameterEstimator::
+  reset()
+  {
+    size_t const nparams(10 * model_->getNNodes());
+    nsamples_ = 0;
+    yty_ = Matrix::Zero(nparams, nparams);
+    ytt_ = Vector::Zero(nparams);
+  }
+  
+  
+  bool ParameterEstimator::
+  addSample(State const & state,
+	    Vector const & acceleration)
+  {
+    if ((model_->getNPositions() != state.position_.size())
+	|| (model_->getNDOF() != state.velocity_.size())
+	|| (model_->getNDOF() != state.force_.size())) {
+      return false;
+    }
+    model_->setState(state);
+    model_->updateKinematics();
+    if ( ! model_->computeRegressor(acceleration, regressor_)) {
+      return false;
+    }
+    // Indexing an empty force_ is undefined, which happens for
+    // models without degrees of freedom.
+    double const * const force(state.force_.empty() ? 0 : &state.force_[0]);
+    return addSample(regressor_, Vector::Map(force, state.force_.size()));
+  }
+  
+  
+  bool ParameterEstimator::
+  addSample(Matrix const & regressor,
+	    Vector const & tau)
+  {
+    if ((model_->getNDOF() != static_cast<size_t>(regressor.rows()))
+	|| (yty_.rows() != regressor.cols())
+	|| (regressor.rows() != tau.size())) {
+      return false;
+    }
+    yty_.selfadjointView<Eigen::Lower>().rankUpdate(regressor.transpose());
+    ytt_ += regressor.transpose() * tau;
+    ++nsamples_;
+    return true;
+  }
+  
+  
+  bool ParameterEstimator::
+  solve(Vector const & prior,
+	double regularization,
+	Vector & parameters) const
+  {
+    if (prior.size() != ytt_.size()) {
+      return false;
+    }
+    Matrix normal(yty_.selfadjointView<Eigen::Lower>());
+    normal.diagonal().array() += regularization;
+    Eigen::LLT<Matrix> const llt(normal);
+    if (llt.info() != Eigen::Success) {
+      return false;
+    }
+    parameters = llt.solve(ytt_ + regularization * prior);
+    return true;
+  }
+  
+}
@@ -0,0 +1,108 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file ParameterEstimator.hpp
+*/
+
+#ifndef MINITAO_PARAMETER_ESTIMATOR_HPP
+#define MINITAO_PARAMETER_ESTIMATOR_HPP
+
+#include "wrap_eigen.hpp"
+
+namespace minitao {
+  
+  class Model;
+  class State;
+  
+  /**
+     Streaming least-squares identification of the inertial
+     parameters of a Model (see Model::computeRegressor()). Each
+     sample adds Y^T * Y and Y^T * tau to the normal equations, so
+     the memory does not grow with the number of samples, and
+     solve() can be called at any time.
+     
+     Some parameters usually do not affect the torque at all, and
+     others only in combination, so the normal equations are
+     regularized towards a prior (typically the parameters from the
+     model description).
+  */
+  class ParameterEstimator
+  {
+  public:
+    /** The model has to stay around for as long as you add samples
+	from states. */
+    explicit ParameterEstimator(Model * model);
+    
+    /** Forget all samples. */
+    void reset();
+    
+    /** Add a logged state. Its force_ field holds the measured joint
+	torque, and the joint acceleration has to be given separately
+	(e.g. from filtered differences of the velocities). This calls
+	Model::setState() and Model::updateKinematics(), so the
+	kinematic quantities of the model refer to this state
+	afterwards.
+	
+	\return True on success. Failure means that the state does not
+	match the model, or that the acceleration or the torque do not
+	have NDOF entries. */
+    bool addSample(State const & state,
+		   Vector const & acceleration);
+    
+    /** Add a sample from a regressor that has already been computed,
+	and the corresponding measured joint torque.
+	
+	\return True on success. Failure means that the sizes do not
+	match the model. */
+    bool addSample(Matrix const & regressor,
+		   Vector const & tau);
+    
+    /** Solve the regularized normal equations
+	(Y^T * Y + regularization * I) * p = Y^T * tau + regularization * prior
+	accumulated over all samples.
+	
+	\return True on success. Failure means that the prior has the
+	wrong size, or that the system is not positive definite (e.g.
+	not enough samples and no regularization). */
+    bool solve(Vector const & prior,
+	       double regularization,
+	       Vector & parameters) const;
+    
+    /** \return The number of samples added since construction or
+	the last reset(). */
+    inline size_t getNSamples() const { return nsamples_; }
+    
+  private:
+    Model * model_;
+    size_t nsamples_;
+    Matrix yty_;
+    Vector ytt_;
+    Matrix regressor_;		// buffer for addSample(State...)
+  };
+  
+}
+
+#endif // MINITAO_PARAMETER_ESTIMATOR_HPP
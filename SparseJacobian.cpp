@@ -0,0 +1,64 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file SparseJacobian.cpp
+*/
+
+#include "SparseJacobian.hpp"
+
+
+namespace minitao {
+  
+  
+  void SparseJacobian::
+  scatter(size_t ndof, Matrix & jacobian) const
+  {
+    jacobian = Matrix::Zero(block_.rows(), ndof);
+    for (size_t ii(0); ii < dof_.size(); ++ii) {
+      jacobian.col(dof_[ii]) = block_.col(ii);
+    }
+  }
+  
+  
+  void SparseJacobian::
+  multiply(Vector const & vv, Vector & result) const
+  {
+    result = Vector::Zero(block_.rows());
+    for (size_t ii(0); ii < dof_.size(); ++ii) {
+      result += block_.col(ii) * vv[dof_[ii]];
+    }
+  }
+  
+  
+  void SparseJacobian::
+  addTransposeProduct(Vector const & ff, Vector & result) const
+  {
+    for (size_t ii(0); ii < dof_.size(); ++ii) {
+      result[dof_[ii]] += block_.col(ii).dot(ff);
+    }
+  }
+  
+}
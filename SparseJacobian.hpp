@@ -0,0 +1,76 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file SparseJacobian.hpp
+*/
+
+#ifndef MINITAO_SPARSE_JACOBIAN_HPP
+#define MINITAO_SPARSE_JACOBIAN_HPP
+
+#include "wrap_eigen.hpp"
+#include <vector>
+
+namespace minitao {
+  
+  /**
+     Compact form of a Jacobian that only stores the columns of the
+     degrees of freedom which actually affect a node, i.e. those of
+     its ancestors (including itself). Filled in by
+     Model::computeSparseJacobian().
+  */
+  class SparseJacobian
+  {
+  public:
+    /** Which rows of the Jacobian to store. */
+    typedef enum {
+      FULL,			/**< 6 rows, linear over angular */
+      POSITION,			/**< 3 rows, linear only */
+      ORIENTATION		/**< 3 rows, angular only */
+    } part_t;
+    
+    /** Write the full-size Jacobian, which has NDOF columns that are
+	zero except for those listed in dof_. */
+    void scatter(size_t ndof, Matrix & jacobian) const;
+    
+    /** Compute the product with a full-size vector (e.g. a joint
+	velocity). Entries of non-ancestor DOF are not accessed. */
+    void multiply(Vector const & vv, Vector & result) const;
+    
+    /** Add the product of the transpose with a vector (e.g. a force)
+	to a full-size vector (e.g. a joint torque). Entries of
+	non-ancestor DOF are left untouched. */
+    void addTransposeProduct(Vector const & ff, Vector & result) const;
+    
+    /** Indices of the contributing DOF, in increasing order. */
+    std::vector<size_t> dof_;
+    
+    /** Dense block with one column per entry of dof_. */
+    Matrix block_;
+  };
+  
+}
+
+#endif // MINITAO_SPARSE_JACOBIAN_HPP
@@ -0,0 +1,903 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file codegen.cpp
+*/
+
+#include "codegen.hpp"
+#include "tao_util.hpp"
+
+#include <tao/dynamics/taoNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <map>
+#include <cmath>
+
+
+namespace {
+
+
+  /** Coefficients below this threshold are considered structural
+      zeros, e.g. the 1e-17 leftovers of quaternion conversions. */
+  static double const zero_threshold(1e-12);
+
+  static double const earth_gravity_z(-9.81);
+
+
+  static double clean(double value)
+  {
+    if (fabs(value) < zero_threshold) {
+      return 0;
+    }
+    return value;
+  }
+
+
+  static std::string index_string(std::string const & array, size_t index)
+  {
+    std::ostringstream os;
+    os << array << "[" << index << "]";
+    return os.str();
+  }
+
+
+  /**
+     Linear combination of symbols plus a constant. Products of two
+     non-constant expressions are materialized as temporaries by the
+     Emitter, so everything stays linear and constants fold
+     automatically.
+  */
+  class Expr
+  {
+  public:
+    typedef std::map<std::string, double> term_t;
+
+    Expr(): cst(0) {}
+    Expr(double value): cst(clean(value)) {}
+
+    static Expr symbol(std::string const & name) {
+      Expr ee;
+      ee.term[name] = 1;
+      return ee;
+    }
+
+    bool isConstant() const { return term.empty(); }
+    bool isZero() const { return term.empty() && (0 == cst); }
+
+    double cst;
+    term_t term;
+  };
+
+
+  static Expr operator + (Expr const & lhs, Expr const & rhs)
+  {
+    Expr result(lhs);
+    result.cst = clean(result.cst + rhs.cst);
+    for (Expr::term_t::const_iterator ii(rhs.term.begin()); ii != rhs.term.end(); ++ii) {
+      double const coeff(clean(result.term[ii->first] + ii->second));
+      if (0 == coeff) {
+	result.term.erase(ii->first);
+      }
+      else {
+	result.term[ii->first] = coeff;
+      }
+    }
+    return result;
+  }
+
+
+  static Expr operator * (double scale, Expr const & rhs)
+  {
+    Expr result;
+    scale = clean(scale);
+    if (0 == scale) {
+      return result;
+    }
+    result.cst = clean(scale * rhs.cst);
+    for (Expr::term_t::const_iterator ii(rhs.term.begin()); ii != rhs.term.end(); ++ii) {
+      double const coeff(clean(scale * ii->second));
+      if (0 != coeff) {
+	result.term[ii->first] = coeff;
+      }
+    }
+    return result;
+  }
+
+
+  static Expr operator - (Expr const & lhs, Expr const & rhs)
+  {
+    return lhs + (-1.0 * rhs);
+  }
+
+
+  /**
+     Writes temporaries and assignments to a stream, caching
+     temporaries by their right-hand side so that repeated
+     subexpressions are only computed once per emitted scope.
+  */
+  class Emitter
+  {
+  public:
+    Emitter(std::ostream & os, std::string const & indent)
+      : os_(os), indent_(indent), ntmp_(0) {}
+
+    std::string format(Expr const & ee) const
+    {
+      std::ostringstream os;
+      os.precision(17);
+      bool first(true);
+      for (Expr::term_t::const_iterator ii(ee.term.begin()); ii != ee.term.end(); ++ii) {
+	double const coeff(ii->second);
+	if (first) {
+	  if (coeff < 0) {
+	    os << "-";
+	  }
+	}
+	else {
+	  os << ((coeff < 0) ? " - " : " + ");
+	}
+	if (fabs(coeff) != 1) {
+	  os << fabs(coeff) << " * ";
+	}
+	os << ii->first;
+	first = false;
+      }
+      if (first) {
+	os << ee.cst;
+      }
+      else if (0 != ee.cst) {
+	os << ((ee.cst < 0) ? " - " : " + ") << fabs(ee.cst);
+      }
+      return os.str();
+    }
+
+    /** \return A literal, a symbol, or the name of a (possibly
+	freshly emitted) temporary which holds the value of ee. */
+    std::string name(Expr const & ee)
+    {
+      if ((1 == ee.term.size()) && (0 == ee.cst) && (1 == ee.term.begin()->second)) {
+	return ee.term.begin()->first;
+      }
+      if (ee.isConstant()) {
+	std::string const lit(format(ee));
+	if (ee.cst < 0) {
+	  return "(" + lit + ")";
+	}
+	return lit;
+      }
+      return temp(format(ee));
+    }
+
+    Expr mul(Expr const & lhs, Expr const & rhs)
+    {
+      if (lhs.isConstant()) {
+	return lhs.cst * rhs;
+      }
+      if (rhs.isConstant()) {
+	return rhs.cst * lhs;
+      }
+      double scale(1);
+      std::string const ll(factor(lhs, scale));
+      std::string const rr(factor(rhs, scale));
+      if (ll < rr) {
+	return scale * Expr::symbol(temp(ll + " * " + rr));
+      }
+      return scale * Expr::symbol(temp(rr + " * " + ll));
+    }
+
+    Expr div(Expr const & num, Expr const & den)
+    {
+      if (den.isConstant()) {
+	return (1.0 / den.cst) * num;
+      }
+      if (num.isZero()) {
+	return num;
+      }
+      return Expr::symbol(temp(name(num) + " / " + name(den)));
+    }
+
+    void assign(std::string const & lhs, Expr const & rhs)
+    {
+      os_ << indent_ << lhs << " = " << format(rhs) << ";\n";
+    }
+
+    void line(std::string const & text)
+    {
+      os_ << indent_ << text << "\n";
+    }
+
+  private:
+    std::string factor(Expr const & ee, double & scale)
+    {
+      if ((1 == ee.term.size()) && (0 == ee.cst)) {
+	scale *= ee.term.begin()->second;
+	return ee.term.begin()->first;
+      }
+      return name(ee);
+    }
+
+    std::string temp(std::string const & value)
+    {
+      std::map<std::string, std::string>::const_iterator const ic(cache_.find(value));
+      if (ic != cache_.end()) {
+	return ic->second;
+      }
+      std::ostringstream name;
+      name << "t" << ntmp_++;
+      std::string const tmp(name.str());
+      cache_[value] = tmp;
+      os_ << indent_ << "double const " << tmp << " = " << value << ";\n";
+      return tmp;
+    }
+
+    std::ostream & os_;
+    std::string indent_;
+    size_t ntmp_;
+    std::map<std::string, std::string> cache_;
+  };
+
+
+  struct Vec3 {
+    Expr v[3];
+  };
+
+  /** Row-major 3x3 matrix. */
+  struct Mat3 {
+    Expr m[9];
+  };
+
+
+  static Vec3 operator + (Vec3 const & lhs, Vec3 const & rhs)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      result.v[ii] = lhs.v[ii] + rhs.v[ii];
+    }
+    return result;
+  }
+
+
+  static Vec3 operator * (double scale, Vec3 const & rhs)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      result.v[ii] = scale * rhs.v[ii];
+    }
+    return result;
+  }
+
+
+  static Vec3 scale(Emitter & em, Expr const & ss, Vec3 const & vv)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      result.v[ii] = em.mul(ss, vv.v[ii]);
+    }
+    return result;
+  }
+
+
+  static Expr dot(Emitter & em, Vec3 const & lhs, Vec3 const & rhs)
+  {
+    return em.mul(lhs.v[0], rhs.v[0]) + em.mul(lhs.v[1], rhs.v[1]) + em.mul(lhs.v[2], rhs.v[2]);
+  }
+
+
+  static Vec3 cross(Emitter & em, Vec3 const & lhs, Vec3 const & rhs)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      size_t const jj((ii + 1) % 3);
+      size_t const kk((ii + 2) % 3);
+      result.v[ii] = em.mul(lhs.v[jj], rhs.v[kk]) - em.mul(lhs.v[kk], rhs.v[jj]);
+    }
+    return result;
+  }
+
+
+  static Vec3 mul(Emitter & em, Mat3 const & mm, Vec3 const & vv)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      for (size_t kk(0); kk < 3; ++kk) {
+	result.v[ii] = result.v[ii] + em.mul(mm.m[3 * ii + kk], vv.v[kk]);
+      }
+    }
+    return result;
+  }
+
+
+  static Vec3 mulT(Emitter & em, Mat3 const & mm, Vec3 const & vv)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      for (size_t kk(0); kk < 3; ++kk) {
+	result.v[ii] = result.v[ii] + em.mul(mm.m[3 * kk + ii], vv.v[kk]);
+      }
+    }
+    return result;
+  }
+
+
+  static Mat3 mul(Emitter & em, Mat3 const & lhs, Mat3 const & rhs)
+  {
+    Mat3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      for (size_t jj(0); jj < 3; ++jj) {
+	for (size_t kk(0); kk < 3; ++kk) {
+	  result.m[3 * ii + jj] = result.m[3 * ii + jj] + em.mul(lhs.m[3 * ii + kk], rhs.m[3 * kk + jj]);
+	}
+      }
+    }
+    return result;
+  }
+
+
+  static Vec3 constant(double const * value)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      result.v[ii] = value[ii];
+    }
+    return result;
+  }
+
+
+  static Vec3 symbols(std::string const & array, size_t offset)
+  {
+    Vec3 result;
+    for (size_t ii(0); ii < 3; ++ii) {
+      result.v[ii] = Expr::symbol(index_string(array, offset + ii));
+    }
+    return result;
+  }
+
+
+  /** Constant properties of a node and its (single) joint, with the
+      home frame expressed as rotation matrix and translation. */
+  struct Link {
+    int id;
+    int parent;
+    bool revolute;
+    double axis[3];
+    double home_rotation[9];
+    double home_translation[3];
+    double mass;
+    double com[3];
+    double inertia[9];
+    double armature;
+  };
+
+
+  static void frame_to_array(deFrame const & frame, double * rotation, double * translation)
+  {
+    deMatrix3 rr;
+    rr.set(frame.rotation());
+    for (int ii(0); ii < 3; ++ii) {
+      for (int jj(0); jj < 3; ++jj) {
+	rotation[3 * ii + jj] = clean(rr[ii][jj]);
+      }
+      translation[ii] = clean(frame.translation()[ii]);
+    }
+  }
+
+
+  static std::vector<Link> extract_links(taoDNode * root)
+  {
+    minitao::nodeVector_t nodes;
+    minitao::enumerateNodes(nodes, root);
+    if (nodes.empty()) {
+      throw std::runtime_error("minitao::generateCompiledModel(): empty tree");
+    }
+    std::map<taoDNode *, int> index;
+    for (size_t ii(0); ii < nodes.size(); ++ii) {
+      index[nodes[ii]] = ii;
+    }
+
+    std::vector<Link> links(nodes.size());
+    for (size_t ii(0); ii < nodes.size(); ++ii) {
+      taoDNode * node(nodes[ii]);
+      Link & link(links[ii]);
+
+      taoJointDOF1 * joint(dynamic_cast<taoJointDOF1*>(node->getJointList()));
+      if (( ! joint) || joint->getNext()
+	  || ((TAO_JOINT_REVOLUTE != joint->getType()) && (TAO_JOINT_PRISMATIC != joint->getType()))
+	  || (joint->getAxis() > TAO_AXIS_Z)) {
+	std::ostringstream msg;
+	msg << "minitao::generateCompiledModel(): node ID " << node->getID()
+	    << " does not have exactly one revolute or prismatic joint about X, Y, or Z";
+	throw std::runtime_error(msg.str());
+      }
+
+      link.id = node->getID();
+      link.parent = (node->getDParent() == root) ? -1 : index[node->getDParent()];
+      link.revolute = (TAO_JOINT_REVOLUTE == joint->getType());
+      for (int jj(0); jj < 3; ++jj) {
+	link.axis[jj] = (jj == joint->getAxis()) ? 1 : 0;
+      }
+      frame_to_array(*node->frameHome(), link.home_rotation, link.home_translation);
+      link.mass = *node->mass();
+      for (int jj(0); jj < 3; ++jj) {
+	link.com[jj] = (*node->center())[jj];
+	for (int kk(0); kk < 3; ++kk) {
+	  link.inertia[3 * jj + kk] = (*node->inertia())[jj][kk];
+	}
+      }
+      link.armature = joint->getInertia();
+    }
+
+    return links;
+  }
+
+
+  /** Rotation of the local frame with respect to the parent,
+      i.e. home rotation times joint rotation. */
+  static Mat3 local_rotation(Link const & link, size_t index)
+  {
+    Mat3 result;
+    if ( ! link.revolute) {
+      for (size_t ii(0); ii < 9; ++ii) {
+	result.m[ii] = link.home_rotation[ii];
+      }
+      return result;
+    }
+
+    // Rodrigues: cos*I + sin*[a]x + (1-cos)*a*a^T
+    Expr const cq(Expr::symbol(index_string("cq_", index)));
+    Expr const sq(Expr::symbol(index_string("sq_", index)));
+    double const * aa(link.axis);
+    double const skew[9] = { 0, -aa[2], aa[1], aa[2], 0, -aa[0], -aa[1], aa[0], 0 };
+    Mat3 joint;
+    for (size_t ii(0); ii < 3; ++ii) {
+      for (size_t jj(0); jj < 3; ++jj) {
+	double const aat(aa[ii] * aa[jj]);
+	joint.m[3 * ii + jj] = Expr(aat) + ((ii == jj ? 1.0 : 0.0) - aat) * cq + skew[3 * ii + jj] * sq;
+      }
+    }
+    for (size_t ii(0); ii < 3; ++ii) {
+      for (size_t jj(0); jj < 3; ++jj) {
+	for (size_t kk(0); kk < 3; ++kk) {
+	  result.m[3 * ii + jj] = result.m[3 * ii + jj] + link.home_rotation[3 * ii + kk] * joint.m[3 * kk + jj];
+	}
+      }
+    }
+    return result;
+  }
+
+
+  /** Origin of the local frame expressed in the parent frame. */
+  static Vec3 local_translation(Link const & link, size_t index)
+  {
+    Vec3 result(constant(link.home_translation));
+    if ( ! link.revolute) {
+      Expr const qq(Expr::symbol(index_string("q_", index)));
+      for (size_t ii(0); ii < 3; ++ii) {
+	for (size_t kk(0); kk < 3; ++kk) {
+	  result.v[ii] = result.v[ii] + (link.home_rotation[3 * ii + kk] * link.axis[kk]) * qq;
+	}
+      }
+    }
+    return result;
+  }
+
+
+  /**
+     Recursive Newton-Euler inverse dynamics, expressed in the local
+     frames with spatial quantities taken at the frame origins. The
+     base acceleration is given in the root frame, pass minus gravity
+     in order to get gravity torques.
+  */
+  static std::vector<Expr> rnea(Emitter & em,
+				std::vector<Link> const & links,
+				std::vector<Expr> const & qd,
+				std::vector<Expr> const & qdd,
+				Vec3 const & base_acceleration)
+  {
+    size_t const nn(links.size());
+    std::vector<Mat3> rot(nn);
+    std::vector<Vec3> trans(nn);
+    std::vector<Vec3> ww(nn), wd(nn), vd(nn), ff(nn), mm(nn);
+
+    for (size_t ii(0); ii < nn; ++ii) {
+      Link const & link(links[ii]);
+      rot[ii] = local_rotation(link, ii);
+      trans[ii] = local_translation(link, ii);
+
+      Vec3 wp, wdp, vdp(base_acceleration);
+      if (link.parent >= 0) {
+	wp = ww[link.parent];
+	wdp = wd[link.parent];
+	vdp = vd[link.parent];
+      }
+
+      Vec3 const pp(trans[ii]);
+      Vec3 const vdo(vdp + cross(em, wdp, pp) + cross(em, wp, cross(em, wp, pp)));
+      Vec3 const axis(constant(link.axis));
+      Vec3 const sqd(scale(em, qd[ii], axis));
+      Vec3 const sqdd(scale(em, qdd[ii], axis));
+
+      ww[ii] = mulT(em, rot[ii], wp);
+      wd[ii] = mulT(em, rot[ii], wdp);
+      vd[ii] = mulT(em, rot[ii], vdo);
+      if (link.revolute) {
+	wd[ii] = wd[ii] + cross(em, ww[ii], sqd) + sqdd;
+	ww[ii] = ww[ii] + sqd;
+      }
+      else {
+	vd[ii] = vd[ii] + 2.0 * cross(em, ww[ii], sqd) + sqdd;
+      }
+
+      Mat3 inertia;
+      for (size_t jj(0); jj < 9; ++jj) {
+	inertia.m[jj] = link.inertia[jj];
+      }
+      Vec3 const com(constant(link.com));
+      ff[ii] = link.mass * (vd[ii] + cross(em, wd[ii], com) + cross(em, ww[ii], cross(em, ww[ii], com)));
+      mm[ii] = mul(em, inertia, wd[ii]) + cross(em, ww[ii], mul(em, inertia, ww[ii]))
+	+ link.mass * cross(em, com, vd[ii]);
+    }
+
+    std::vector<Expr> tau(nn);
+    for (size_t ii(nn); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      Link const & link(links[jj]);
+      Vec3 const axis(constant(link.axis));
+      tau[jj] = dot(em, axis, link.revolute ? mm[jj] : ff[jj]) + link.armature * qdd[jj];
+      if (link.parent >= 0) {
+	Vec3 const fp(mul(em, rot[jj], ff[jj]));
+	ff[link.parent] = ff[link.parent] + fp;
+	mm[link.parent] = mm[link.parent] + mul(em, rot[jj], mm[jj]) + cross(em, trans[jj], fp);
+      }
+    }
+
+    return tau;
+  }
+
+
+  /** \return The lower triangle (row >= column) of the mass-inertia
+      matrix, computed one column at a time with unit accelerations. */
+  static std::vector<std::vector<Expr> > mass_inertia(Emitter & em, std::vector<Link> const & links)
+  {
+    size_t const nn(links.size());
+    std::vector<std::vector<Expr> > aa(nn, std::vector<Expr>(nn));
+    std::vector<Expr> const zero(nn);
+    for (size_t kk(0); kk < nn; ++kk) {
+      std::vector<Expr> qdd(nn);
+      qdd[kk] = 1;
+      std::vector<Expr> const col(rnea(em, links, zero, qdd, Vec3()));
+      for (size_t ii(kk); ii < nn; ++ii) {
+	aa[ii][kk] = col[ii];
+      }
+    }
+    return aa;
+  }
+
+
+  static void emit_set_state(std::ostream & os, std::string const & class_name,
+			     std::vector<Link> const & links, taoDNode * root)
+  {
+    os << "  void " << class_name << "::\n"
+       << "  setState(double const * position, double const * velocity)\n"
+       << "  {\n";
+    Emitter em(os, "    ");
+    for (size_t ii(0); ii < links.size(); ++ii) {
+      std::ostringstream text;
+      text << "q_[" << ii << "] = position[" << ii << "];";
+      if (links[ii].revolute) {
+	text << " cq_[" << ii << "] = cos(position[" << ii << "]);"
+	     << " sq_[" << ii << "] = sin(position[" << ii << "]);";
+      }
+      text << " dq_[" << ii << "] = velocity[" << ii << "];";
+      em.line(text.str());
+    }
+
+    double root_rotation[9], root_translation[3];
+    frame_to_array(*root->frameGlobal(), root_rotation, root_translation);
+
+    for (size_t ii(0); ii < links.size(); ++ii) {
+      Link const & link(links[ii]);
+      Mat3 rp;
+      Vec3 pp;
+      if (link.parent < 0) {
+	for (size_t jj(0); jj < 9; ++jj) {
+	  rp.m[jj] = root_rotation[jj];
+	}
+	pp = constant(root_translation);
+      }
+      else {
+	for (size_t jj(0); jj < 9; ++jj) {
+	  rp.m[jj] = Expr::symbol(index_string("R_", 9 * link.parent + jj));
+	}
+	pp = symbols("p_", 3 * link.parent);
+      }
+
+      Mat3 const rg(mul(em, rp, local_rotation(link, ii)));
+      Vec3 const pg(pp + mul(em, rp, local_translation(link, ii)));
+      for (size_t jj(0); jj < 9; ++jj) {
+	em.assign(index_string("R_", 9 * ii + jj), rg.m[jj]);
+      }
+      for (size_t jj(0); jj < 3; ++jj) {
+	em.assign(index_string("p_", 3 * ii + jj), pg.v[jj]);
+      }
+
+      Mat3 rs;
+      for (size_t jj(0); jj < 9; ++jj) {
+	rs.m[jj] = Expr::symbol(index_string("R_", 9 * ii + jj));
+      }
+      Vec3 const zz(mul(em, rs, constant(link.axis)));
+      for (size_t jj(0); jj < 3; ++jj) {
+	em.assign(index_string("z_", 3 * ii + jj), zz.v[jj]);
+      }
+    }
+    os << "  }\n\n";
+  }
+
+
+  static void emit_jacobian(std::ostream & os, std::string const & class_name,
+			    std::vector<Link> const & links)
+  {
+    size_t const nn(links.size());
+    os << "  void " << class_name << "::\n"
+       << "  computeJacobian(size_t index, double gx, double gy, double gz, double * jacobian) const\n"
+       << "  {\n"
+       << "    for (size_t ii(0); ii < " << 6 * nn << "; ++ii) {\n"
+       << "      jacobian[ii] = 0;\n"
+       << "    }\n"
+       << "    switch (index) {\n";
+    Vec3 gg;
+    gg.v[0] = Expr::symbol("gx");
+    gg.v[1] = Expr::symbol("gy");
+    gg.v[2] = Expr::symbol("gz");
+    for (size_t ii(0); ii < nn; ++ii) {
+      os << "    case " << ii << ": {\n";
+      Emitter em(os, "      ");
+      for (int jj(ii); jj >= 0; jj = links[jj].parent) {
+	Vec3 const zz(symbols("z_", 3 * jj));
+	if (links[jj].revolute) {
+	  Vec3 const lin(cross(em, zz, gg + (-1.0 * symbols("p_", 3 * jj))));
+	  for (size_t kk(0); kk < 3; ++kk) {
+	    em.assign(index_string("jacobian", 6 * jj + kk), lin.v[kk]);
+	    em.assign(index_string("jacobian", 6 * jj + kk + 3), zz.v[kk]);
+	  }
+	}
+	else {
+	  for (size_t kk(0); kk < 3; ++kk) {
+	    em.assign(index_string("jacobian", 6 * jj + kk), zz.v[kk]);
+	  }
+	}
+      }
+      os << "      break;\n"
+	 << "    }\n";
+    }
+    os << "    default:\n"
+       << "      break;\n"
+       << "    }\n"
+       << "  }\n\n";
+  }
+
+
+  static void emit_gravity(std::ostream & os, std::string const & class_name,
+			   std::vector<Link> const & links, taoDNode * root)
+  {
+    os << "  void " << class_name << "::\n"
+       << "  computeGravity(double * gravity) const\n"
+       << "  {\n";
+    Emitter em(os, "    ");
+    double root_rotation[9], root_translation[3];
+    frame_to_array(*root->frameGlobal(), root_rotation, root_translation);
+    Vec3 base;
+    for (size_t ii(0); ii < 3; ++ii) {
+      base.v[ii] = - earth_gravity_z * root_rotation[6 + ii];
+    }
+    std::vector<Expr> const zero(links.size());
+    std::vector<Expr> const tau(rnea(em, links, zero, zero, base));
+    for (size_t ii(0); ii < links.size(); ++ii) {
+      em.assign(index_string("gravity", ii), tau[ii]);
+    }
+    os << "  }\n\n";
+  }
+
+
+  static void emit_coriolis_centrifugal(std::ostream & os, std::string const & class_name,
+					std::vector<Link> const & links)
+  {
+    os << "  void " << class_name << "::\n"
+       << "  computeCoriolisCentrifugal(double * coriolis_centrifugal) const\n"
+       << "  {\n";
+    Emitter em(os, "    ");
+    std::vector<Expr> qd(links.size());
+    for (size_t ii(0); ii < links.size(); ++ii) {
+      qd[ii] = Expr::symbol(index_string("dq_", ii));
+    }
+    std::vector<Expr> const zero(links.size());
+    std::vector<Expr> const tau(rnea(em, links, qd, zero, Vec3()));
+    for (size_t ii(0); ii < links.size(); ++ii) {
+      em.assign(index_string("coriolis_centrifugal", ii), tau[ii]);
+    }
+    os << "  }\n\n";
+  }
+
+
+  static void emit_mass_inertia(std::ostream & os, std::string const & class_name,
+				std::vector<Link> const & links)
+  {
+    size_t const nn(links.size());
+    os << "  void " << class_name << "::\n"
+       << "  computeMassInertia(double * mass_inertia) const\n"
+       << "  {\n";
+    Emitter em(os, "    ");
+    std::vector<std::vector<Expr> > const aa(mass_inertia(em, links));
+    for (size_t ii(0); ii < nn; ++ii) {
+      for (size_t jj(0); jj <= ii; ++jj) {
+	em.assign(index_string("mass_inertia", ii + nn * jj), aa[ii][jj]);
+	if (ii != jj) {
+	  em.assign(index_string("mass_inertia", jj + nn * ii), aa[ii][jj]);
+	}
+      }
+    }
+    os << "  }\n\n";
+  }
+
+
+  /**
+     Inverts the mass-inertia matrix through an A = L^T D L
+     factorization which eliminates from the leaves towards the root,
+     so that a kinematic tree in depth-first order produces no
+     fill-in (Featherstone's LTDL).
+  */
+  static void emit_inverse_mass_inertia(std::ostream & os, std::string const & class_name,
+					std::vector<Link> const & links)
+  {
+    size_t const nn(links.size());
+    os << "  void " << class_name << "::\n"
+       << "  computeInverseMassInertia(double * inverse_mass_inertia) const\n"
+       << "  {\n";
+    Emitter em(os, "    ");
+    std::vector<std::vector<Expr> > hh(mass_inertia(em, links));
+
+    for (size_t kk(nn); kk > 0; --kk) {
+      size_t const k1(kk - 1);
+      for (size_t ii(k1); ii > 0; --ii) {
+	size_t const i1(ii - 1);
+	if (hh[k1][i1].isZero()) {
+	  continue;
+	}
+	Expr const ratio(em.div(hh[k1][i1], hh[k1][k1]));
+	for (size_t jj(0); jj <= i1; ++jj) {
+	  hh[i1][jj] = hh[i1][jj] - em.mul(hh[k1][jj], ratio);
+	}
+	hh[k1][i1] = ratio;
+      }
+    }
+
+    // X = inverse(L), unit lower triangular
+    std::vector<std::vector<Expr> > xx(nn, std::vector<Expr>(nn));
+    for (size_t ii(0); ii < nn; ++ii) {
+      xx[ii][ii] = 1;
+      for (size_t jj(0); jj < ii; ++jj) {
+	Expr sum;
+	for (size_t mm(jj); mm < ii; ++mm) {
+	  sum = sum + em.mul(hh[ii][mm], xx[mm][jj]);
+	}
+	xx[ii][jj] = -1.0 * sum;
+      }
+    }
+
+    // inverse(A) = X inverse(D) X^T
+    std::vector<Expr> dinv(nn);
+    for (size_t mm(0); mm < nn; ++mm) {
+      dinv[mm] = em.div(1.0, hh[mm][mm]);
+    }
+    for (size_t ii(0); ii < nn; ++ii) {
+      for (size_t jj(0); jj <= ii; ++jj) {
+	Expr sum;
+	for (size_t mm(0); mm <= jj; ++mm) {
+	  sum = sum + em.mul(em.mul(xx[ii][mm], dinv[mm]), xx[jj][mm]);
+	}
+	em.assign(index_string("inverse_mass_inertia", ii + nn * jj), sum);
+	if (ii != jj) {
+	  em.assign(index_string("inverse_mass_inertia", jj + nn * ii), sum);
+	}
+      }
+    }
+    os << "  }\n\n";
+  }
+
+}
+
+
+namespace minitao {
+
+
+  void generateCompiledModel(std::ostream & os,
+			     taoDNode * root,
+			     std::string const & class_name)
+  {
+    std::vector<Link> const links(extract_links(root));
+    size_t const nn(links.size());
+
+    os << "// Generated by minitao::generateCompiledModel(), do not edit.\n\n"
+       << "#include \"CompiledModel.hpp\"\n"
+       << "#include <cmath>\n\n"
+       << "namespace {\n\n"
+       << "  static int const node_id[" << nn << "] = {";
+    for (size_t ii(0); ii < nn; ++ii) {
+      os << ((ii == 0) ? " " : ", ") << links[ii].id;
+    }
+    os << " };\n\n"
+       << "  class " << class_name << "\n"
+       << "    : public minitao::CompiledModel\n"
+       << "  {\n"
+       << "  public:\n"
+       << "    " << class_name << "() {\n"
+       << "      double const zero[" << nn << "] = { 0 };\n"
+       << "      setState(zero, zero);\n"
+       << "    }\n\n"
+       << "    virtual size_t getNNodes() const { return " << nn << "; }\n"
+       << "    virtual size_t getNDOF() const { return " << nn << "; }\n"
+       << "    virtual int getNodeID(size_t index) const { return node_id[index]; }\n"
+       << "    virtual void setState(double const * position, double const * velocity);\n\n"
+       << "    virtual void getGlobalFrame(size_t index, double * rotation, double * translation) const {\n"
+       << "      for (size_t ii(0); ii < 3; ++ii) {\n"
+       << "        for (size_t jj(0); jj < 3; ++jj) {\n"
+       << "          rotation[ii + 3 * jj] = R_[9 * index + 3 * ii + jj];\n"
+       << "        }\n"
+       << "        translation[ii] = p_[3 * index + ii];\n"
+       << "      }\n"
+       << "    }\n\n"
+       << "    virtual void computeJacobian(size_t index, double gx, double gy, double gz, double * jacobian) const;\n"
+       << "    virtual void computeGravity(double * gravity) const;\n"
+       << "    virtual void computeCoriolisCentrifugal(double * coriolis_centrifugal) const;\n"
+       << "    virtual void computeMassInertia(double * mass_inertia) const;\n"
+       << "    virtual void computeInverseMassInertia(double * inverse_mass_inertia) const;\n\n"
+       << "  private:\n"
+       << "    double q_[" << nn << "];\n"
+       << "    double dq_[" << nn << "];\n"
+       << "    double cq_[" << nn << "];\n"
+       << "    double sq_[" << nn << "];\n"
+       << "    double R_[" << 9 * nn << "];\n"
+       << "    double p_[" << 3 * nn << "];\n"
+       << "    double z_[" << 3 * nn << "];\n"
+       << "  };\n\n";
+
+    emit_set_state(os, class_name, links, root);
+    emit_jacobian(os, class_name, links);
+    emit_gravity(os, class_name, links, root);
+    emit_coriolis_centrifugal(os, class_name, links);
+    emit_mass_inertia(os, class_name, links);
+    emit_inverse_mass_inertia(os, class_name, links);
+
+    os << "}\n\n"
+       << "extern \"C\" minitao::CompiledModel * minitao_create_compiled_model()\n"
+       << "{\n"
+       << "  return new " << class_name << "();\n"
+       << "}\n";
+  }
+
+}
@@ -0,0 +1,63 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file codegen.hpp
+*/
+
+#ifndef MINITAO_CODEGEN_HPP
+#define MINITAO_CODEGEN_HPP
+
+#include <iosfwd>
+#include <string>
+
+class taoDNode;
+
+namespace minitao {
+
+
+  /**
+     Write C++ source code for a robot-specific implementation of
+     the CompiledModel interface. The kinematic structure, home
+     frames, joint axes, and mass properties of the given TAO tree
+     are folded into straight-line code for the forward kinematics,
+     Jacobians, gravity, Coriolis-centrifugal, mass-inertia, and
+     inverse mass-inertia computations, such that multiplications by
+     structural zeros and ones disappear.
+
+     The emitted translation unit only includes CompiledModel.hpp
+     and <cmath>. Compile it into a shared library and pass that to
+     loadCompiledModel().
+
+     \note Throws a \c runtime_error if the tree contains anything
+     other than exactly one revolute or prismatic joint per node.
+  */
+  void generateCompiledModel(std::ostream & os,
+			     taoDNode * root,
+			     std::string const & class_name);
+
+}
+
+#endif // MINITAO_CODEGEN_HPP
@@ -0,0 +1,833 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file spatial.cpp
+*/
+
+#include "spatial.hpp"
+#include <tao/dynamics/taoNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <map>
+
+
+namespace minitao {
+  
+  
+  Eigen::Matrix3d skew(Eigen::Vector3d const & vv)
+  {
+    Eigen::Matrix3d result;
+    result <<        0, -vv.z(),  vv.y(),
+		vv.z(),        0, -vv.x(),
+	       -vv.y(),  vv.x(),        0;
+    return result;
+  }
+  
+  
+  // Spatial cross product for motion vectors: crm(v) * m == v x m
+  static spatial_matrix_t crm(spatial_vector_t const & vv)
+  {
+    spatial_matrix_t result(spatial_matrix_t::Zero());
+    Eigen::Matrix3d const wx(skew(vv.head<3>()));
+    result.topLeftCorner<3, 3>() = wx;
+    result.bottomLeftCorner<3, 3>() = skew(vv.tail<3>());
+    result.bottomRightCorner<3, 3>() = wx;
+    return result;
+  }
+  
+  
+  // Spatial cross product for force vectors: crf(v) * f == v x* f
+  static spatial_matrix_t crf(spatial_vector_t const & vv)
+  {
+    return - crm(vv).transpose();
+  }
+  
+  
+  // The force cross product with swapped arguments:
+  // crfbar(f) * v == crf(v) * f
+  static spatial_matrix_t crfbar(spatial_vector_t const & ff)
+  {
+    spatial_matrix_t result(spatial_matrix_t::Zero());
+    Eigen::Matrix3d const fx(skew(ff.tail<3>()));
+    result.topLeftCorner<3, 3>() = - skew(ff.head<3>());
+    result.topRightCorner<3, 3>() = - fx;
+    result.bottomLeftCorner<3, 3>() = - fx;
+    return result;
+  }
+  
+  
+  Eigen::Matrix3d global_rotation(taoDNode * node)
+  {
+    deQuaternion const & qq(node->frameGlobal()->rotation());
+    return minitao::Quaternion(qq[3], qq[0], qq[1], qq[2]).toRotationMatrix();
+  }
+  
+  
+  Eigen::Vector3d global_translation(taoDNode * node)
+  {
+    deVector3 const & tt(node->frameGlobal()->translation());
+    return Eigen::Vector3d(tt[0], tt[1], tt[2]);
+  }
+  
+  
+  // Motion subspace of the joint of a node, in global coordinates,
+  // with one column per DOF. Spherical and free joints take their
+  // velocity in node coordinates (linear before angular for free
+  // joints), so their columns are the axes of the node frame.
+  // Returns false unless the node has exactly one revolute,
+  // prismatic, spherical, or free joint.
+  static bool compute_motion_subspace(taoDNode * node, spatial_block_t & motion_subspace)
+  {
+    taoJoint * joint(node->getJointList());
+    if (( ! joint) || joint->getNext()) {
+      return false;
+    }
+    Eigen::Matrix3d const rot(global_rotation(node));
+    Eigen::Vector3d const pos(global_translation(node));
+    switch (joint->getType()) {
+    case TAO_JOINT_REVOLUTE:
+    case TAO_JOINT_PRISMATIC:
+      {
+	deInt const axis_index(static_cast<taoJointDOF1 *>(joint)->getAxis());
+	if (axis_index > TAO_AXIS_Z) {
+	  return false;
+	}
+	Eigen::Vector3d const axis(rot.col(axis_index));
+	motion_subspace.resize(6, 1);
+	if (TAO_JOINT_REVOLUTE == joint->getType()) {
+	  motion_subspace.col(0).head<3>() = axis;
+	  motion_subspace.col(0).tail<3>() = pos.cross(axis);
+	}
+	else {
+	  motion_subspace.col(0).head<3>().setZero();
+	  motion_subspace.col(0).tail<3>() = axis;
+	}
+      }
+      return true;
+    case TAO_JOINT_SPHERICAL:
+      motion_subspace.resize(6, 3);
+      for (int ii(0); ii < 3; ++ii) {
+	motion_subspace.col(ii).head<3>() = rot.col(ii);
+	motion_subspace.col(ii).tail<3>() = pos.cross(rot.col(ii));
+      }
+      return true;
+    case TAO_JOINT_FREE:
+      motion_subspace.resize(6, 6);
+      for (int ii(0); ii < 3; ++ii) {
+	motion_subspace.col(ii).head<3>().setZero();
+	motion_subspace.col(ii).tail<3>() = rot.col(ii);
+	motion_subspace.col(ii + 3).head<3>() = rot.col(ii);
+	motion_subspace.col(ii + 3).tail<3>() = pos.cross(rot.col(ii));
+      }
+      return true;
+    default:
+      break;
+    }
+    return false;
+  }
+  
+  
+  // Spatial inertia of a node, in global coordinates at the global
+  // origin.
+  static void compute_spatial_inertia(taoDNode * node, spatial_matrix_t & inertia)
+  {
+    double const mass(*node->mass());
+    Eigen::Matrix3d const rot(global_rotation(node));
+    deVector3 const & lcom(*node->center());
+    Eigen::Vector3d const local_com(lcom[0], lcom[1], lcom[2]);
+    deMatrix3 const & lin(*node->inertia());
+    Eigen::Matrix3d local_inertia;	// about the node origin
+    for (int ii(0); ii < 3; ++ii) {
+      for (int jj(0); jj < 3; ++jj) {
+	local_inertia.coeffRef(ii, jj) = lin[ii][jj];
+      }
+    }
+    Eigen::Matrix3d const lcx(skew(local_com));
+    Eigen::Matrix3d const com_inertia(rot * (local_inertia + mass * lcx * lcx) * rot.transpose());
+    Eigen::Matrix3d const cx(skew(global_translation(node) + rot * local_com));
+    inertia.topLeftCorner<3, 3>() = com_inertia - mass * cx * cx;
+    inertia.topRightCorner<3, 3>() = mass * cx;
+    inertia.bottomLeftCorner<3, 3>() = - mass * cx;
+    inertia.bottomRightCorner<3, 3>() = mass * Eigen::Matrix3d::Identity();
+  }
+  
+  
+  void compute_parents(nodeVector_t const & nodes, std::vector<int> & parent)
+  {
+    std::map<taoDNode const *, int> index;
+    for (size_t ii(0); ii < nodes.size(); ++ii) {
+      index[nodes[ii]] = ii;
+    }
+    parent.resize(nodes.size());
+    for (size_t ii(0); ii < nodes.size(); ++ii) {
+      std::map<taoDNode const *, int>::const_iterator const ip(index.find(nodes[ii]->getDParent()));
+      parent[ii] = (index.end() == ip) ? -1 : ip->second;
+    }
+  }
+  
+  
+  bool global_gravity_basis(nodeVector_t const & nodes,
+			    std::vector<int> const & parent,
+			    gravity_scratch_s & scratch,
+			    Matrix & basis)
+  {
+    size_t const nnodes(nodes.size());
+    scratch.motion_subspace.resize(nnodes);
+    scratch.mass.resize(nnodes);
+    scratch.moment.resize(nnodes);
+    std::vector<spatial_block_t> & ss(scratch.motion_subspace);
+    std::vector<double> & mass(scratch.mass);
+    std::vector<Eigen::Vector3d> & moment(scratch.moment);
+    size_t ndof(0);
+    for (size_t ii(0); ii < nnodes; ++ii) {
+      taoDNode * node(nodes[ii]);
+      if ( ! compute_motion_subspace(node, ss[ii])) {
+	return false;
+      }
+      ndof += ss[ii].cols();
+      deVector3 const & lcom(*node->center());
+      mass[ii] = *node->mass();
+      moment[ii] = mass[ii] * (global_translation(node)
+			       + global_rotation(node) * Eigen::Vector3d(lcom[0], lcom[1], lcom[2]));
+    }
+    for (size_t ii(nnodes); ii > 0; --ii) {
+      int const pp(parent[ii - 1]);
+      if (pp >= 0) {
+	mass[pp] += mass[ii - 1];
+	moment[pp] += moment[ii - 1];
+      }
+    }
+    // The joint has to hold the opposite of the weight of the
+    // subtree, whose moment about the global origin is m c x g, and
+    // w . (m c x g) == (w x m c) . g for the angular part w of the
+    // motion subspace.
+    basis.resize(ndof, 3);
+    for (size_t ii(0), idof(0); ii < nnodes; ++ii) {
+      for (int icol(0); icol < ss[ii].cols(); ++icol, ++idof) {
+	basis.row(idof) = - (ss[ii].col(icol).head<3>().cross(moment[ii])
+			     + mass[ii] * ss[ii].col(icol).tail<3>()).transpose();
+      }
+    }
+    return true;
+  }
+  
+  
+  bool compute_global_tree(nodeVector_t const & nodes,
+			   global_tree_s & tree)
+  {
+    std::vector<int> node_parent;
+    compute_parents(nodes, node_parent);
+    std::vector<int> node_last(nodes.size());
+    tree.parent.clear();
+    tree.first.clear();
+    tree.last.clear();
+    tree.motion_subspace.clear();
+    tree.inertia.clear();
+    tree.armature.clear();
+    spatial_block_t ss;
+    for (size_t ii(0); ii < nodes.size(); ++ii) {
+      if ( ! compute_motion_subspace(nodes[ii], ss)) {
+	return false;
+      }
+      // Parents come before their children in the node list.
+      int const first(tree.parent.size());
+      int const last(first + ss.cols() - 1);
+      tree.parent.push_back((node_parent[ii] >= 0) ? node_last[node_parent[ii]] : -1);
+      for (int icol(1); icol < ss.cols(); ++icol) {
+	tree.parent.push_back(first + icol - 1);
+      }
+      tree.first.insert(tree.first.end(), ss.cols(), first);
+      tree.last.insert(tree.last.end(), ss.cols(), last);
+      for (int icol(0); icol < ss.cols(); ++icol) {
+	tree.motion_subspace.push_back(ss.col(icol));
+      }
+      tree.inertia.insert(tree.inertia.end(), ss.cols(), spatial_matrix_t::Zero());
+      compute_spatial_inertia(nodes[ii], tree.inertia.back());
+      tree.armature.insert(tree.armature.end(), ss.cols(), nodes[ii]->getJointList()->getInertia());
+      node_last[ii] = last;
+    }
+    return true;
+  }
+  
+  
+  bool global_rnea(nodeVector_t const & nodes,
+		   double const * velocity,
+		   double const * acceleration,
+		   Vector * tau,
+		   Matrix * dtau_dposition,
+		   Matrix * dtau_dvelocity,
+		   Matrix * mass_inertia,
+		   Matrix * coriolis)
+  {
+    global_tree_s tree;
+    if ( ! compute_global_tree(nodes, tree)) {
+      return false;
+    }
+    size_t const ndof(tree.parent.size());
+    std::vector<int> const & parent(tree.parent);
+    std::vector<spatial_vector_t> const & ss(tree.motion_subspace);
+    std::vector<spatial_matrix_t> inertia(tree.inertia);
+    std::vector<spatial_vector_t> ssd(ndof), ssdd(ndof), sdj(ndof), vel(ndof), acc(ndof), force(ndof);
+    std::vector<spatial_matrix_t> bb(ndof);
+    
+    // minus gravity as base acceleration takes care of the weights
+    spatial_vector_t base_acc(spatial_vector_t::Zero());
+    base_acc[5] = 9.81;
+    
+    for (size_t ii(0); ii < ndof; ++ii) {
+      // ssd and ssdd use the parent of the node, whereas velocity and
+      // acceleration accumulate along the elements of the joint.
+      spatial_vector_t vp(spatial_vector_t::Zero());
+      spatial_vector_t ap(base_acc);
+      int const pn(parent[tree.first[ii]]);
+      if (pn >= 0) {
+	vp = vel[pn];
+	ap = acc[pn];
+      }
+      spatial_matrix_t const vpx(crm(vp));
+      ssd[ii] = vpx * ss[ii];
+      ssdd[ii] = crm(ap) * ss[ii] + vpx * ssd[ii];
+      if (parent[ii] >= 0) {
+	vel[ii] = vel[parent[ii]] + ss[ii] * velocity[ii];
+	acc[ii] = acc[parent[ii]] + ss[ii] * acceleration[ii] + ssd[ii] * velocity[ii];
+      }
+      else {
+	vel[ii] = ss[ii] * velocity[ii];
+	acc[ii] = base_acc + ss[ii] * acceleration[ii] + ssd[ii] * velocity[ii];
+      }
+      
+      if (static_cast<int>(ii) != tree.last[ii]) {
+	force[ii].setZero();
+	bb[ii].setZero();
+	continue;
+      }
+      spatial_vector_t const momentum(inertia[ii] * vel[ii]);
+      spatial_matrix_t const vfx(crf(vel[ii]));
+      force[ii] = inertia[ii] * acc[ii] + vfx * momentum;
+      bb[ii] = vfx * inertia[ii] + crfbar(momentum) - inertia[ii] * crm(vel[ii]);
+      
+      // The columns move along with the node, so their actual time
+      // derivative uses its velocity. This differs from ssd only
+      // for joints with several DOF.
+      for (int jj(tree.first[ii]); jj <= static_cast<int>(ii); ++jj) {
+	sdj[jj] = crm(vel[ii]) * ss[jj];
+      }
+    }
+    
+    // Accumulate composite quantities from the leaves to the root.
+    // Afterwards inertia, bb, and force hold the sums over subtrees.
+    for (size_t ii(ndof); ii > 0; --ii) {
+      int const pp(parent[ii - 1]);
+      if (pp >= 0) {
+	inertia[pp] += inertia[ii - 1];
+	bb[pp] += bb[ii - 1];
+	force[pp] += force[ii - 1];
+      }
+    }
+    
+    if (tau) {
+      tau->resize(ndof);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	(*tau)[ii] = ss[ii].dot(force[ii]) + tree.armature[ii] * acceleration[ii];
+      }
+    }
+    
+    if (dtau_dposition) {
+      dtau_dposition->setZero(ndof, ndof);
+    }
+    if (dtau_dvelocity) {
+      dtau_dvelocity->setZero(ndof, ndof);
+    }
+    if (mass_inertia) {
+      mass_inertia->setZero(ndof, ndof);
+    }
+    if (coriolis) {
+      coriolis->setZero(ndof, ndof);
+    }
+    
+    for (size_t ii(0); ii < ndof; ++ii) {
+      // Entries (ii, jj) where jj is an ancestor of ii (or ii itself)
+      // use the composite quantities of the row...
+      spatial_vector_t const sic(inertia[ii] * ss[ii]);
+      spatial_vector_t const sib(bb[ii].transpose() * ss[ii]);
+      for (int jj(ii); jj >= 0; jj = parent[jj]) {
+	if (dtau_dposition) {
+	  dtau_dposition->coeffRef(ii, jj) = sic.dot(ssdd[jj]) + sib.dot(ssd[jj]);
+	}
+	if (dtau_dvelocity) {
+	  dtau_dvelocity->coeffRef(ii, jj) = sic.dot(ssd[jj] + sdj[jj]) + sib.dot(ss[jj]);
+	}
+	if (mass_inertia) {
+	  mass_inertia->coeffRef(ii, jj) = sic.dot(ss[jj]);
+	  mass_inertia->coeffRef(jj, ii) = mass_inertia->coeff(ii, jj);
+	}
+	if (coriolis) {
+	  coriolis->coeffRef(ii, jj) = sic.dot(sdj[jj]) + 0.5 * sib.dot(ss[jj]);
+	}
+      }
+      
+      // ...whereas entries (jj, ii) where jj is a strict ancestor of
+      // ii use those of the column. Within a joint, the column of jj
+      // moves along with ii, which cancels the force cross product.
+      spatial_vector_t const uj(inertia[ii] * ssdd[ii] + bb[ii] * ssd[ii]);
+      spatial_vector_t const uu(crf(ss[ii]) * force[ii] + uj);
+      spatial_vector_t const ww(inertia[ii] * (ssd[ii] + sdj[ii]) + bb[ii] * ss[ii]);
+      spatial_vector_t const cc(inertia[ii] * sdj[ii] + 0.5 * bb[ii] * ss[ii]);
+      for (int jj(parent[ii]); jj >= 0; jj = parent[jj]) {
+	if (dtau_dposition) {
+	  dtau_dposition->coeffRef(jj, ii) = ss[jj].dot((tree.first[jj] == tree.first[ii]) ? uj : uu);
+	}
+	if (dtau_dvelocity) {
+	  dtau_dvelocity->coeffRef(jj, ii) = ss[jj].dot(ww);
+	}
+	if (coriolis) {
+	  coriolis->coeffRef(jj, ii) = ss[jj].dot(cc);
+	}
+      }
+      
+      if (mass_inertia) {
+	mass_inertia->coeffRef(ii, ii) += tree.armature[ii];
+      }
+    }
+    
+    return true;
+  }
+  
+  
+  /**
+     Linear map from the ten inertial parameters of a body to the
+     force (moment first) that it needs for the given spatial
+     velocity and acceleration, all expressed in its own frame at its
+     origin. The parameters are the mass, the first moment
+     mass * com, and the inertia about the origin in the order xx,
+     xy, xz, yy, yz, zz.
+  */
+  static Eigen::Matrix<double, 6, 10> body_regressor(spatial_vector_t const & vel,
+						     spatial_vector_t const & acc)
+  {
+    Eigen::Vector3d const ww(vel.head<3>());
+    Eigen::Vector3d const vv(vel.tail<3>());
+    Eigen::Vector3d const dw(acc.head<3>());
+    Eigen::Vector3d const dv(acc.tail<3>());
+    Eigen::Matrix3d const wx(skew(ww));
+    Eigen::Matrix3d const vx(skew(vv));
+    Eigen::Matrix<double, 6, 10> result(Eigen::Matrix<double, 6, 10>::Zero());
+    result.block<3, 1>(3, 0) = dv + ww.cross(vv);
+    result.block<3, 3>(0, 1) = vx * wx - wx * vx - skew(dv);
+    result.block<3, 3>(3, 1) = skew(dw) + wx * wx;
+    // The inertia times a vector, as a function of the inertia
+    // parameters, for the angular acceleration and velocity.
+    Eigen::Matrix<double, 3, 6> ldw, lww;
+    ldw <<
+      dw.x(), dw.y(), dw.z(),      0,      0,      0,
+           0, dw.x(),      0, dw.y(), dw.z(),      0,
+           0,      0, dw.x(),      0, dw.y(), dw.z();
+    lww <<
+      ww.x(), ww.y(), ww.z(),      0,      0,      0,
+           0, ww.x(),      0, ww.y(), ww.z(),      0,
+           0,      0, ww.x(),      0, ww.y(), ww.z();
+    result.block<3, 6>(0, 4) = ldw + wx * lww;
+    return result;
+  }
+  
+  
+  /**
+     Express a spatial motion vector (global coordinates, at the
+     global origin) in the frame of a node, at the node origin.
+  */
+  static spatial_vector_t to_node_frame(Eigen::Matrix3d const & rot,
+					Eigen::Vector3d const & pos,
+					spatial_vector_t const & mm)
+  {
+    spatial_vector_t result;
+    result.head<3>() = rot.transpose() * mm.head<3>();
+    result.tail<3>() = rot.transpose() * (mm.tail<3>() + mm.head<3>().cross(pos));
+    return result;
+  }
+  
+  
+  void global_regressor(global_tree_s const & tree,
+			nodeVector_t const & nodes,
+			double const * velocity,
+			double const * acceleration,
+			bool with_gravity,
+			Matrix & regressor)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<int> const & parent(tree.parent);
+    std::vector<spatial_vector_t> const & ss(tree.motion_subspace);
+    std::vector<spatial_vector_t> vel(ndof), acc(ndof);
+    regressor.setZero(ndof, 10 * nodes.size());
+    
+    spatial_vector_t base_acc(spatial_vector_t::Zero());
+    if (with_gravity) {
+      base_acc[5] = 9.81;
+    }
+    
+    size_t node(0);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      // As in global_rnea(), the velocity product term uses the
+      // parent of the node.
+      int const pn(parent[tree.first[ii]]);
+      spatial_vector_t ssd(spatial_vector_t::Zero());
+      if (pn >= 0) {
+	ssd = crm(vel[pn]) * ss[ii];
+      }
+      if (parent[ii] >= 0) {
+	vel[ii] = vel[parent[ii]] + ss[ii] * velocity[ii];
+	acc[ii] = acc[parent[ii]] + ss[ii] * acceleration[ii] + ssd * velocity[ii];
+      }
+      else {
+	vel[ii] = ss[ii] * velocity[ii];
+	acc[ii] = base_acc + ss[ii] * acceleration[ii];
+      }
+      if (static_cast<int>(ii) != tree.last[ii]) {
+	continue;
+      }
+      
+      Eigen::Matrix3d const rot(global_rotation(nodes[node]));
+      Eigen::Vector3d const pos(global_translation(nodes[node]));
+      Eigen::Matrix<double, 6, 10> const
+	yy(body_regressor(to_node_frame(rot, pos, vel[ii]), to_node_frame(rot, pos, acc[ii])));
+      for (int jj(ii); jj >= 0; jj = parent[jj]) {
+	regressor.block<1, 10>(jj, 10 * node) = to_node_frame(rot, pos, ss[jj]).transpose() * yy;
+      }
+      ++node;
+    }
+  }
+  
+  
+  void global_mass_inertia_regressor(global_tree_s const & tree,
+				     nodeVector_t const & nodes,
+				     Matrix & regressor)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<int> const & parent(tree.parent);
+    regressor.setZero(ndof * (ndof + 1) / 2, 10 * nodes.size());
+    spatial_vector_t const zero(spatial_vector_t::Zero());
+    std::vector<spatial_vector_t> ss(ndof);
+    std::vector<Eigen::Matrix<double, 6, 10> > force(ndof);
+    
+    size_t node(0);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      if (static_cast<int>(ii) != tree.last[ii]) {
+	continue;
+      }
+      Eigen::Matrix3d const rot(global_rotation(nodes[node]));
+      Eigen::Vector3d const pos(global_translation(nodes[node]));
+      for (int jj(ii); jj >= 0; jj = parent[jj]) {
+	ss[jj] = to_node_frame(rot, pos, tree.motion_subspace[jj]);
+	force[jj] = body_regressor(zero, ss[jj]);
+      }
+      // Parents have smaller indices, so jj >= kk in the packed
+      // lower triangle.
+      for (int jj(ii); jj >= 0; jj = parent[jj]) {
+	for (int kk(jj); kk >= 0; kk = parent[kk]) {
+	  regressor.block<1, 10>(jj * (jj + 1) / 2 + kk, 10 * node) += ss[kk].transpose() * force[jj];
+	}
+      }
+      ++node;
+    }
+  }
+  
+  
+  void global_mass_inertia_product(global_tree_s const & tree,
+				   Matrix const & xx,
+				   Matrix & result)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<spatial_block_t> acc(ndof), force(ndof);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      acc[ii] = tree.motion_subspace[ii] * xx.row(ii);
+      if (tree.parent[ii] >= 0) {
+	acc[ii] += acc[tree.parent[ii]];
+      }
+      force[ii] = tree.inertia[ii] * acc[ii];
+    }
+    result.resize(ndof, xx.cols());
+    for (size_t ii(ndof); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      if (tree.parent[jj] >= 0) {
+	force[tree.parent[jj]] += force[jj];
+      }
+      result.row(jj) = tree.motion_subspace[jj].transpose() * force[jj] + tree.armature[jj] * xx.row(jj);
+    }
+  }
+  
+  
+  void compute_articulated_factors(global_tree_s const & tree,
+				   articulated_factors_s & factors)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<spatial_matrix_t> ia(tree.inertia);
+    factors.uu.resize(ndof);
+    factors.dd.resize(ndof);
+    for (size_t ii(ndof); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      factors.uu[jj] = ia[jj] * tree.motion_subspace[jj];
+      factors.dd[jj] = tree.motion_subspace[jj].dot(factors.uu[jj]) + tree.armature[jj];
+      if (tree.parent[jj] >= 0) {
+	ia[tree.parent[jj]] += ia[jj] - factors.uu[jj] * factors.uu[jj].transpose() / factors.dd[jj];
+      }
+    }
+  }
+  
+  
+  void global_inverse_mass_inertia_product(global_tree_s const & tree,
+					   articulated_factors_s const & factors,
+					   Matrix const & yy,
+					   Matrix & result)
+  {
+    size_t const ndof(tree.parent.size());
+    int const ncols(yy.cols());
+    std::vector<spatial_block_t> bias(ndof, spatial_block_t::Zero(6, ncols));
+    Matrix uu(ndof, ncols);
+    for (size_t ii(ndof); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      uu.row(jj) = yy.row(jj) - tree.motion_subspace[jj].transpose() * bias[jj];
+      if (tree.parent[jj] >= 0) {
+	bias[tree.parent[jj]] += bias[jj] + factors.uu[jj] * uu.row(jj) / factors.dd[jj];
+      }
+    }
+    result.resize(ndof, ncols);
+    std::vector<spatial_block_t> acc(ndof);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      if (tree.parent[ii] >= 0) {
+	spatial_block_t const & ap(acc[tree.parent[ii]]);
+	result.row(ii) = (uu.row(ii) - factors.uu[ii].transpose() * ap) / factors.dd[ii];
+	acc[ii] = ap + tree.motion_subspace[ii] * result.row(ii);
+      }
+      else {
+	result.row(ii) = uu.row(ii) / factors.dd[ii];
+	acc[ii] = tree.motion_subspace[ii] * result.row(ii);
+      }
+    }
+  }
+  
+  
+  void global_hybrid_dynamics(global_tree_s const & tree,
+			      double const * velocity,
+			      std::vector<bool> const & acceleration_given,
+			      Vector & acceleration,
+			      Vector & tau)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<spatial_vector_t> const & ss(tree.motion_subspace);
+    std::vector<spatial_vector_t> vel(ndof), cc(ndof), pa(ndof), uu(ndof), acc(ndof);
+    std::vector<spatial_matrix_t> ia(tree.inertia);
+    std::vector<double> dd(ndof), ut(ndof);
+    
+    for (size_t ii(0); ii < ndof; ++ii) {
+      int const pp(tree.parent[ii]);
+      int const pn(tree.parent[tree.first[ii]]);
+      vel[ii] = ss[ii] * velocity[ii];
+      if (pp >= 0) {
+	vel[ii] += vel[pp];
+      }
+      if (pn >= 0) {
+	cc[ii] = crm(vel[pn]) * ss[ii] * velocity[ii];
+      }
+      else {
+	cc[ii].setZero();
+      }
+      pa[ii] = crf(vel[ii]) * tree.inertia[ii] * vel[ii];
+    }
+    
+    for (size_t ii(ndof); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      int const pp(tree.parent[jj]);
+      if (acceleration_given[jj]) {
+	if (pp >= 0) {
+	  ia[pp] += ia[jj];
+	  pa[pp] += pa[jj] + ia[jj] * (cc[jj] + ss[jj] * acceleration[jj]);
+	}
+      }
+      else {
+	uu[jj] = ia[jj] * ss[jj];
+	dd[jj] = ss[jj].dot(uu[jj]) + tree.armature[jj];
+	ut[jj] = tau[jj] - ss[jj].dot(pa[jj]);
+	if (pp >= 0) {
+	  ia[pp] += ia[jj] - uu[jj] * uu[jj].transpose() / dd[jj];
+	  pa[pp] += pa[jj] + ia[jj] * cc[jj] + uu[jj] * (ut[jj] - uu[jj].dot(cc[jj])) / dd[jj];
+	}
+      }
+    }
+    
+    // minus gravity as base acceleration takes care of the weights
+    spatial_vector_t base_acc(spatial_vector_t::Zero());
+    base_acc[5] = 9.81;
+    
+    for (size_t ii(0); ii < ndof; ++ii) {
+      spatial_vector_t const ap((tree.parent[ii] >= 0) ? acc[tree.parent[ii]] : base_acc);
+      if (acceleration_given[ii]) {
+	acc[ii] = ap + cc[ii] + ss[ii] * acceleration[ii];
+	tau[ii] = ss[ii].dot(ia[ii] * acc[ii] + pa[ii]) + tree.armature[ii] * acceleration[ii];
+      }
+      else {
+	acceleration[ii] = (ut[ii] - uu[ii].dot(ap + cc[ii])) / dd[ii];
+	acc[ii] = ap + cc[ii] + ss[ii] * acceleration[ii];
+      }
+    }
+  }
+  
+  
+  void global_delassus(global_tree_s const & tree,
+		       articulated_factors_s const & factors,
+		       std::vector<size_t> const & contact_node,
+		       std::vector<spatial_block_t> const & contact_map,
+		       Matrix & delassus)
+  {
+    size_t const ndof(tree.parent.size());
+    int ncols(0);
+    for (size_t ic(0); ic < contact_map.size(); ++ic) {
+      ncols += contact_map[ic].cols();
+    }
+    std::vector<spatial_block_t> force_map(ndof);
+    std::vector<bool> active(ndof, false);
+    for (size_t ic(0), offset(0); ic < contact_node.size(); offset += contact_map[ic].cols(), ++ic) {
+      size_t const jj(contact_node[ic]);
+      if ( ! active[jj]) {
+	force_map[jj] = spatial_block_t::Zero(6, ncols);
+	active[jj] = true;
+      }
+      force_map[jj].block(0, offset, 6, contact_map[ic].cols()) = contact_map[ic];
+    }
+    
+    delassus = Matrix::Zero(ncols, ncols);
+    for (size_t ii(ndof); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      if ( ! active[jj]) {
+	continue;
+      }
+      Eigen::RowVectorXd const st_b(tree.motion_subspace[jj].transpose() * force_map[jj]);
+      delassus.noalias() += st_b.transpose() * st_b / factors.dd[jj];
+      int const parent(tree.parent[jj]);
+      if (parent >= 0) {
+	if ( ! active[parent]) {
+	  force_map[parent] = spatial_block_t::Zero(6, ncols);
+	  active[parent] = true;
+	}
+	force_map[parent] += force_map[jj] - factors.uu[jj] * st_b / factors.dd[jj];
+      }
+    }
+  }
+  
+  
+  spatial_block_t point_force_map(Eigen::Vector3d const & point, bool with_moment)
+  {
+    spatial_block_t result(spatial_block_t::Zero(6, with_moment ? 6 : 3));
+    result.topLeftCorner<3, 3>() = skew(point);
+    result.bottomLeftCorner<3, 3>() = Eigen::Matrix3d::Identity();
+    if (with_moment) {
+      result.topRightCorner<3, 3>() = Eigen::Matrix3d::Identity();
+    }
+    return result;
+  }
+  
+  
+  void global_add_force_torque(global_tree_s const & tree,
+			       std::vector<size_t> const & force_node,
+			       std::vector<spatial_vector_t> const & force,
+			       Vector & tau)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<spatial_vector_t> subtree_force(ndof, spatial_vector_t::Zero());
+    for (size_t ic(0); ic < force_node.size(); ++ic) {
+      subtree_force[force_node[ic]] += force[ic];
+    }
+    for (size_t ii(ndof); ii > 0; --ii) {
+      size_t const jj(ii - 1);
+      tau[jj] += tree.motion_subspace[jj].dot(subtree_force[jj]);
+      if (tree.parent[jj] >= 0) {
+	subtree_force[tree.parent[jj]] += subtree_force[jj];
+      }
+    }
+  }
+  
+  
+  bool global_centroidal(global_tree_s const & tree,
+			 double const * velocity,
+			 double & total_mass,
+			 Eigen::Vector3d & com,
+			 Matrix & momentum_matrix,
+			 Vector * momentum_bias)
+  {
+    size_t const ndof(tree.parent.size());
+    std::vector<spatial_matrix_t> composite(tree.inertia);
+    spatial_matrix_t total(spatial_matrix_t::Zero());
+    for (size_t ii(ndof); ii > 0; --ii) {
+      int const pp(tree.parent[ii - 1]);
+      if (pp >= 0) {
+	composite[pp] += composite[ii - 1];
+      }
+      else {
+	total += composite[ii - 1];
+      }
+    }
+    
+    // the top right block of a spatial inertia is mass * skew(com)
+    total_mass = total.coeff(5, 5);
+    if (total_mass <= 0) {
+      return false;
+    }
+    com = Eigen::Vector3d(total.coeff(2, 4), total.coeff(0, 5), total.coeff(1, 3)) / total_mass;
+    
+    momentum_matrix.resize(6, ndof);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      spatial_vector_t const momentum(composite[ii] * tree.motion_subspace[ii]);
+      momentum_matrix.block<3, 1>(0, ii) = momentum.tail<3>();
+      momentum_matrix.block<3, 1>(3, ii) = momentum.head<3>() - com.cross(momentum.tail<3>());
+    }
+    
+    if (momentum_bias) {
+      std::vector<spatial_vector_t> vel(ndof), acc(ndof);
+      spatial_vector_t force(spatial_vector_t::Zero());
+      for (size_t ii(0); ii < ndof; ++ii) {
+	spatial_vector_t vp(spatial_vector_t::Zero());
+	spatial_vector_t ap(spatial_vector_t::Zero());
+	if (tree.parent[ii] >= 0) {
+	  vp = vel[tree.parent[ii]];
+	  ap = acc[tree.parent[ii]];
+	}
+	vel[ii] = vp + tree.motion_subspace[ii] * velocity[ii];
+	acc[ii] = ap;
+	int const pn(tree.parent[tree.first[ii]]);
+	if (pn >= 0) {
+	  acc[ii] += crm(vel[pn]) * tree.motion_subspace[ii] * velocity[ii];
+	}
+	force += tree.inertia[ii] * acc[ii] + crf(vel[ii]) * tree.inertia[ii] * vel[ii];
+      }
+      // The CoM velocity is parallel to the linear momentum, so the
+      // rate of angular momentum about the (moving) CoM is simply the
+      // moment of the total force about it.
+      momentum_bias->resize(6);
+      momentum_bias->head<3>() = force.tail<3>();
+      momentum_bias->tail<3>() = force.head<3>() - com.cross(force.tail<3>());
+    }
+    
+    return true;
+  }
+  
+}
@@ -0,0 +1,314 @@
+/*
+ * MiniTAO http://gitorious.org/minitao
+ *
+ * Copyright (c) 2026 Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+   \file spatial.hpp
+   
+   Rigid body dynamics in global coordinates, using Featherstone's
+   spatial vectors. The functions read the global frames and mass
+   properties of TAO nodes, but they run their own sweeps instead
+   of going through taoDynamics, for quantities that the TAO passes
+   do not provide: analytical derivatives, multi-column products,
+   contact and end-effector couplings, regressors, and the like.
+*/
+
+#ifndef MINITAO_SPATIAL_HPP
+#define MINITAO_SPATIAL_HPP
+
+#include "tao_util.hpp"
+#include "wrap_eigen.hpp"
+#include <vector>
+
+
+namespace minitao {
+  
+  
+  /** Spatial vectors in Featherstone order [angular; linear],
+      expressed in global coordinates and taken at the global
+      origin. */
+  typedef Eigen::Matrix<double, 6, 1> spatial_vector_t;
+  typedef Eigen::Matrix<double, 6, 6> spatial_matrix_t;
+  typedef Eigen::Matrix<double, 6, Eigen::Dynamic> spatial_block_t;
+  
+  
+  /** Cross product matrix: skew(a) * b == a x b */
+  Eigen::Matrix3d skew(Eigen::Vector3d const & vv);
+  
+  
+  /** Rotation of the global frame of a node, which has to be up to
+      date. */
+  Eigen::Matrix3d global_rotation(taoDNode * node);
+  
+  
+  /** Origin of the global frame of a node, which has to be up to
+      date. */
+  Eigen::Vector3d global_translation(taoDNode * node);
+  
+  
+  /** Index of the parent of each node, or -1 for children of the
+      root. */
+  void compute_parents(nodeVector_t const & nodes, std::vector<int> & parent);
+  
+  
+  /** Per-node scratch space of global_gravity_basis(). Callers can
+      keep it around, so that repeated calls do not allocate. */
+  struct gravity_scratch_s {
+    std::vector<spatial_block_t> motion_subspace;
+    std::vector<double> mass;
+    std::vector<Eigen::Vector3d> moment;
+  };
+  
+  
+  /**
+     Gravity basis from the masses and first mass moments (mass times
+     global center of mass) of the subtrees, accumulated in one pass
+     from the leaves to the root and then projected onto the joint
+     motion subspaces. The gravity torque for a gravity vector g is
+     basis * g, which gives the same result as inverse dynamics at
+     rest, without any of the velocity and acceleration terms.
+     
+     \return False if a node has an unsupported joint.
+  */
+  bool global_gravity_basis(nodeVector_t const & nodes,
+			    std::vector<int> const & parent,
+			    gravity_scratch_s & scratch,
+			    Matrix & basis);
+  
+  
+  /**
+     Configuration-dependent quantities of a tree, all in global
+     coordinates, with one element per degree of freedom. The joint
+     of a node with several DOF becomes a chain of elements, in the
+     order of its DOF, of which only the last one carries the spatial
+     inertia of the node and has the children of the node attached to
+     it. This way, the sweeps only ever deal with one motion subspace
+     column at a time.
+     
+     The velocity of the last element of a node is the velocity of
+     the node, but the intermediate elements do not correspond to any
+     body. The time derivative of a motion subspace column thus has
+     to be taken with the velocity of the parent of the node, which
+     is the element before the first one of the node.
+  */
+  struct global_tree_s {
+    std::vector<int> parent;
+    std::vector<int> first;	// first element of the same node
+    std::vector<int> last;	// last element of the same node
+    std::vector<spatial_vector_t> motion_subspace;
+    std::vector<spatial_matrix_t> inertia;
+    std::vector<double> armature;
+  };
+  
+  
+  /**
+     Fill a global_tree_s from the global frames and mass properties
+     of the nodes, which thus have to be up to date.
+     
+     \return False if a node has an unsupported joint.
+  */
+  bool compute_global_tree(nodeVector_t const & nodes,
+			   global_tree_s & tree);
+  
+  
+  /**
+     Recursive Newton-Euler inverse dynamics in global coordinates,
+     with earth gravity. Optionally computes the partial derivatives of the
+     joint torques with respect to position and velocity, following
+     Carpentier and Mansard, "Analytical Derivatives of Rigid Body
+     Dynamics Algorithms" (RSS 2018), and the mass-inertia matrix
+     from the composite inertias, and the Coriolis matrix C following
+     Echeandia and Wensing, "Numerical Methods to Compute the Coriolis
+     Matrix and Christoffel Symbols for Rigid-Body Systems" (JCND
+     2021), such that C * velocity is the velocity product torque and
+     the time derivative of the mass-inertia matrix minus 2 * C is
+     skew-symmetric. Their body-level factor is half of the bb used
+     for the derivatives. Pass NULL for anything you do not need.
+     
+     The position derivatives are taken with respect to joint
+     displacements expressed like the joint velocity, i.e. in node
+     coordinates for spherical and free joints. Perturbing one DOF of
+     such a joint moves the motion subspace columns of all its DOF
+     along with the node, so the entries between two DOF of the same
+     joint all follow the formula for a DOF and its ancestors.
+     
+     The global frames of the nodes have to be up to date, the
+     velocity and acceleration are taken from the arguments.
+     
+     \return False if a node has an unsupported joint.
+  */
+  bool global_rnea(nodeVector_t const & nodes,
+		   double const * velocity,
+		   double const * acceleration,
+		   Vector * tau,
+		   Matrix * dtau_dposition,
+		   Matrix * dtau_dvelocity,
+		   Matrix * mass_inertia,
+		   Matrix * coriolis);
+  
+  
+  /**
+     Inverse dynamics regressor in global coordinates, optionally
+     with earth gravity: the NDOF x (10 * nodes.size()) matrix that
+     maps the inertial parameters of all nodes (in node coordinates,
+     see Model::getInertialParameters()) to the joint torque. The velocities and
+     accelerations are propagated like in global_rnea(), and each
+     body regressor is projected onto the motion subspaces of its
+     ancestors expressed in the node frame. Joint inertias are not
+     included. The tree has to be computed from the same nodes.
+  */
+  void global_regressor(global_tree_s const & tree,
+			nodeVector_t const & nodes,
+			double const * velocity,
+			double const * acceleration,
+			bool with_gravity,
+			Matrix & regressor);
+  
+  
+  /**
+     Mass-inertia regressor: the (NDOF * (NDOF + 1) / 2) x (10 *
+     nodes.size()) matrix that maps the inertial parameters of all
+     nodes to the lower triangle of the mass-inertia matrix, packed
+     row by row. Entry (ii, jj) with jj <= ii is the sum over the
+     nodes that both DOF move of the ii motion subspace column times
+     the force that the node needs for the jj column as
+     acceleration. Joint inertias are not included.
+  */
+  void global_mass_inertia_regressor(global_tree_s const & tree,
+				     nodeVector_t const & nodes,
+				     Matrix & regressor);
+  
+  
+  /**
+     Multiply the mass-inertia matrix with several columns at once,
+     using a zero-velocity zero-gravity Newton-Euler sweep on blocks
+     of spatial vectors.
+  */
+  void global_mass_inertia_product(global_tree_s const & tree,
+				   Matrix const & xx,
+				   Matrix & result);
+  
+  
+  /**
+     Zero-velocity articulated-body factors: U = IA * S and
+     D = S^T * IA * S + armature, where IA is the articulated inertia.
+  */
+  struct articulated_factors_s {
+    std::vector<spatial_vector_t> uu;
+    std::vector<double> dd;
+  };
+  
+  
+  /** Fill articulated_factors_s from a tree. */
+  void compute_articulated_factors(global_tree_s const & tree,
+				   articulated_factors_s & factors);
+  
+  
+  /**
+     Multiply the inverse mass-inertia matrix with several columns at
+     once, using the bias-force and acceleration sweeps of the
+     articulated-body algorithm on precomputed factors.
+  */
+  void global_inverse_mass_inertia_product(global_tree_s const & tree,
+					   articulated_factors_s const & factors,
+					   Matrix const & yy,
+					   Matrix & result);
+  
+  
+  /**
+     Hybrid dynamics following Featherstone, "Rigid Body Dynamics
+     Algorithms" (2008), section 9.2: the articulated-body algorithm
+     for trees in which the joints flagged in \c acceleration_given
+     have a known acceleration instead of a known torque. The
+     articulated inertia of such a joint is handed to its parent as
+     if the joint were rigid, along with the bias force of the
+     prescribed motion. Velocity and earth gravity are included.
+     
+     The entries of \c acceleration and \c tau that are not given
+     are filled in.
+  */
+  void global_hybrid_dynamics(global_tree_s const & tree,
+			      double const * velocity,
+			      std::vector<bool> const & acceleration_given,
+			      Vector & acceleration,
+			      Vector & tau);
+  
+  
+  /**
+     Contact-space inverse inertia J Ainv J^T, where each contact is
+     given by the element of global_tree_s that carries the inertia
+     of the node it is attached to, and the map from its contact
+     force coordinates to the spatial force at the global origin. The
+     force maps are propagated towards the root through the
+     articulated-body projections (I - U S^T / d), and every joint
+     adds its contribution (S^T B)^T (S^T B) / d, which includes the
+     coupling between all contacts in its subtree. Nodes without
+     contacts in their subtree are skipped.
+  */
+  void global_delassus(global_tree_s const & tree,
+		       articulated_factors_s const & factors,
+		       std::vector<size_t> const & contact_node,
+		       std::vector<spatial_block_t> const & contact_map,
+		       Matrix & delassus);
+  
+  
+  /**
+     Map a linear force, or a force and moment, applied at a point to
+     the spatial force at the global origin. The columns correspond
+     to the linear force first and then to the moment.
+  */
+  spatial_block_t point_force_map(Eigen::Vector3d const & point, bool with_moment);
+  
+  
+  /**
+     Add J^T f to the joint torque, for spatial forces applied to a
+     set of elements (see global_delassus()), by accumulating them
+     from the leaves to the root.
+  */
+  void global_add_force_torque(global_tree_s const & tree,
+			       std::vector<size_t> const & force_node,
+			       std::vector<spatial_vector_t> const & force,
+			       Vector & tau);
+  
+  
+  /**
+     Total mass, center of mass, and centroidal momentum matrix
+     (linear over angular, angular part about the center of mass),
+     all from the composite inertias: the mass and the first mass
+     moment of a subtree can be read off the entries of its spatial
+     inertia. Optionally computes the centroidal momentum rate due to
+     the given velocity at zero joint acceleration.
+     
+     \return False if the tree has no mass.
+  */
+  bool global_centroidal(global_tree_s const & tree,
+			 double const * velocity,
+			 double & total_mass,
+			 Eigen::Vector3d & com,
+			 Matrix & momentum_matrix,
+			 Vector * momentum_bias);
+  
+}
+
+#endif // MINITAO_SPATIAL_HPP
@@ -355,3 +355,154 @@ void taoABJointSpherical::plusEq_S_inertia_ddQ(deVector6& F, const deVector6& A)
 	tau.multiply(A[1], getInertia());
 	F[1] += tau;
 }
+
+void taoABJointFree::update_localX(const deTransform& home, const deFrame&)
+{
+	deFrame f;
+	f.set(getVarFree()->_Q, getVarFree()->_P);
+
+	deTransform local;
+	local.set(f);
+
+	localX().multiply(home, local);
+}
+
+// Vi = hXi^T Vh + Si dqi;
+// S = 1
+void taoABJointFree::plusEq_SdQ(deVector6& V)
+{
+	V += getVarFree()->_dQ;
+}
+
+// Ci = Wi X Vi - Xt (Wh X Vh) + Vi X Si dqi
+// V X S dq = V X dq
+void taoABJointFree::plusEq_V_X_SdQ(deVector6& C, const deVector6& V)
+{
+	deVector6 tmpV6;
+	tmpV6.crossMultiply(V, getVarFree()->_dQ);
+	C += tmpV6;
+}
+
+// Dinv = inv(St Ia S) = inv(Ia)
+// SbarT = Ia S Dinv = Ia Dinv
+void taoABJointFree::compute_Dinv_and_SbarT(const deMatrix6& Ia)
+{
+	deMatrix6 D;
+	D = Ia;
+	for (deInt i = 0; i < 6; i++)
+		D.elementAt(i, i) += getInertia();
+	_Dinv.inverseSPD(D);
+
+	_SbarT.multiply(Ia, _Dinv);
+}
+
+// L = X - X SbarT St = X - X SbarT
+void taoABJointFree::minusEq_X_SbarT_St(deMatrix6& L, const deTransform& localX)
+{
+	deMatrix6 tmpM6;
+	tmpM6.xform(localX, _SbarT);
+	L -= tmpM6;
+}
+
+// Pah = Ph - Fexth + sum [ Li (Iai Ci + Pai) + X SbarTi taui ]
+void taoABJointFree::plusEq_X_SbarT_Tau(deVector6& Pah, const deTransform& localX)
+{
+	deVector6 tmpV61, tmpV62;
+	tmpV61.multiply(_SbarT, getVarFree()->_Tau);
+	tmpV62.xform(localX, tmpV61);
+	Pah += tmpV62;
+}
+
+void taoABJointFree::compute_Tau(const deVector6& F)
+{
+// see taoABNode::netForce()
+	getVarFree()->_Tau.multiply(getVarFree()->_ddQ, getInertia());
+	getVarFree()->_Tau += F;
+}
+
+// ddQ = Dinv*(tau - St*Pa) - Sbar*(X Ah + Ci)
+// Ai = (X Ah + Ci) + Si ddQi;
+void taoABJointFree::compute_ddQ(const deVector6& Pa, const deVector6& XAh_C)
+{
+	compute_ddQ_zeroTauPa(XAh_C);
+
+	deVector6 tmpV, tmpV1;
+	tmpV1.subtract(getVarFree()->_Tau, Pa);
+	tmpV.multiply(_Dinv, tmpV1);
+	getVarFree()->_ddQ += tmpV;
+}
+
+// ddQ = Dinv*(- St*Pa) - Sbar*(X Ah + Ci)
+void taoABJointFree::compute_ddQ_zeroTau(const deVector6& Pa, const deVector6& XAh_C)
+{
+	compute_ddQ_zeroTauPa(XAh_C);
+
+	deVector6 tmpV;
+	tmpV.multiply(_Dinv, Pa);
+	getVarFree()->_ddQ -= tmpV;
+}
+
+// ddQ = - Sbar*(X Ah + Ci) = - (SbarT)^t * (X Ah + Ci)
+void taoABJointFree::compute_ddQ_zeroTauPa(const deVector6& XAh_C)
+{
+	deVector6 tmpV;
+	tmpV.transposedMultiply(_SbarT, XAh_C);
+	getVarFree()->_ddQ.negate(tmpV);
+}
+
+void taoABJointFree::plusEq_SddQ(deVector6& A)
+{
+	A += getVarFree()->_ddQ;
+}
+
+void taoABJointFree::minusEq_SdQ_damping(deVector6& B, const deMatrix6& Ia)
+{
+	deVector6 tmpV;
+	tmpV.multiply(Ia, getVarFree()->_dQ);
+	tmpV *= (- getDamping());
+	B -= tmpV;
+}
+
+void taoABJointFree::plusEq_S_Dinv_St(deMatrix6& Omega)
+{
+	Omega += _Dinv;
+}
+
+// 0Jn = Jn = iXn^T Si = 0Xi^(-T) Si
+// where 0Xi^(-T) = [ R rxR; 0 R ], and S = 1
+void taoABJointFree::compute_Jg(const deTransform &globalX)
+{
+	deVector6 unit, col;
+	for (deInt k = 0; k < 6; k++)
+	{
+		unit.zero();
+		unit.elementAt(k) = 1;
+		col.xformInvT(globalX, unit);
+		for (deInt i = 0; i < 6; i++)
+			_Jg.elementAt(i, k) = col.elementAt(i);
+	}
+}
+
+// Ag += Jg * ddQ
+void taoABJointFree::plusEq_Jg_ddQ(deVector6& Ag)
+{
+	deVector6 JddQ;
+	JddQ.multiply(_Jg, getVarFree()->_dQ);
+	Ag += JddQ;
+}
+
+// Tau += JgT * F
+void taoABJointFree::add2Tau_JgT_F(const deVector6& Fg)
+{
+	deVector6 JtF;
+	JtF.transposedMultiply(_Jg, Fg);
+	getVarFree()->_Tau += JtF;
+}
+
+// F += S * inertia * ddQ
+void taoABJointFree::plusEq_S_inertia_ddQ(deVector6& F, const deVector6& A)
+{
+	deVector6 tau;
+	tau.multiply(A, getInertia());
+	F += tau;
+}
@@ -30,6 +30,7 @@
 class taoDVar;
 class taoVarDOF1;
 class taoVarSpherical;
+class taoVarFree;
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
@@ -191,6 +192,57 @@ private:
 	deMatrix3 _Jg[2];
 };
 
+/*!
+ *	\brief		Free-flyer (6-DOF) articulated body joint class
+ *	\ingroup	taoDynamics
+ *
+ *	The motion subspace is the 6x6 identity, so the joint velocity
+ *	is the spatial velocity of the child relative to the parent,
+ *	expressed in the child frame. This replaces the stack of three
+ *	prismatic and one spherical joint that taoGroup::unlinkFree()
+ *	used to build, and which went through taoABNodeNOJn.
+ */
+class taoABJointFree : public taoABJoint
+{
+public:
+	taoABJointFree(taoDJoint* joint) : taoABJoint(joint)
+	{
+		_SbarT.zero();
+		_Dinv.zero();
+		_Jg.zero();
+	}
+	virtual void update_localX(const deTransform& home, const deFrame& localFrame);
+	virtual void plusEq_SdQ(deVector6& V);
+	virtual void plusEq_V_X_SdQ(deVector6& C, const deVector6& V);
+	virtual void compute_Dinv_and_SbarT(const deMatrix6& Ia);
+	virtual void minusEq_X_SbarT_St(deMatrix6& L, const deTransform& localX);
+	virtual void plusEq_X_SbarT_Tau(deVector6& Pah, const deTransform& localX);
+	virtual void compute_ddQ(const deVector6& Pa, const deVector6& XAh_C);
+	virtual void compute_ddQ_zeroTau(const deVector6& Pa, const deVector6& XAh_C);
+	virtual void compute_ddQ_zeroTauPa(const deVector6& XAh_C);
+	virtual void compute_Tau(const deVector6& F);
+
+	virtual void plusEq_SddQ(deVector6& A);
+	virtual void minusEq_SdQ_damping(deVector6& B, const deMatrix6& Ia);
+	virtual void plusEq_S_Dinv_St(deMatrix6& Omega);
+
+	virtual void compute_Jg(const deTransform &globalX);
+	virtual void plusEq_Jg_ddQ(deVector6& Ag);
+	virtual void add2Tau_JgT_F(const deVector6& Fg);
+
+	virtual void plusEq_S_inertia_ddQ(deVector6& F, const deVector6& A);
+
+	virtual taoVarFree* getVarFree() { return (taoVarFree*)getDVar(); }
+
+	//! column k is the global Jacobian column of the k-th DOF
+	virtual deMatrix6& Jg() { return _Jg; }
+
+private:
+	deMatrix6 _SbarT;
+	deMatrix6 _Dinv;
+	deMatrix6 _Jg;
+};
+
 class taoABJointDOF1 : public taoABJoint
 {
 public:
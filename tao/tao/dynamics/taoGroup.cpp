@@ -203,40 +203,14 @@ taoNodeRoot* taoGroup::unlinkFree(taoNodeRoot* root, taoNode* node, deFloat iner
 
 	node->link(r, &home);
 
-	taoJointDOF1* joint;
-
-	joint = new taoJointPrismatic(TAO_AXIS_X);
-	joint->setDamping(damping);
-	joint->setInertia(inertia);
-	joint->setDVar(new taoVarDOF1);
-	joint->reset();
-	joint->getVarDOF1()->_dQ = v[0][TAO_AXIS_X];
-	node->addJoint(joint);
-
-	joint = new taoJointPrismatic(TAO_AXIS_Y);
+	taoJointFree* joint = new taoJointFree;
 	joint->setDamping(damping);
 	joint->setInertia(inertia);
-	joint->setDVar(new taoVarDOF1);
+	joint->setDVar(new taoVarFree);
 	joint->reset();
-	joint->getVarDOF1()->_dQ = v[0][TAO_AXIS_Y];
+	joint->getVarFree()->_dQ = v;
 	node->addJoint(joint);
 
-	joint = new taoJointPrismatic(TAO_AXIS_Z);
-	joint->setDamping(damping);
-	joint->setInertia(inertia);
-	joint->setDVar(new taoVarDOF1);
-	joint->reset();
-	joint->getVarDOF1()->_dQ = v[0][TAO_AXIS_Z];
-	node->addJoint(joint);
-
-	taoJointSpherical* joint2 = new taoJointSpherical;
-	joint2->setDamping(damping);
-	joint2->setInertia(inertia);
-	joint2->setDVar(new taoVarSpherical);
-	joint2->reset();
-	joint2->getVarSpherical()->_dQ = v[1];
-	node->addJoint(joint2);
-
 	node->addABNode();
 	taoDynamics::initialize(r);
 
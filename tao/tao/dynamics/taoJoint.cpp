@@ -123,6 +123,90 @@ void taoJointSpherical::getJgColumns(deVector6 * Jg_columns) const
   }
 }
 
+taoJointFree::taoJointFree()
+{
+	setABJoint(new taoABJointFree(this));
+	setType(TAO_JOINT_FREE);
+}
+
+void taoJointFree::reset()
+{
+	getVarFree()->_P.zero();
+	getVarFree()->_Q.identity();
+	getVarFree()->_dQ.zero();
+	getVarFree()->_ddQ.zero();
+	getVarFree()->_Tau.zero();
+}
+
+void taoJointFree::getQ(deFloat* v)
+{
+	getVarFree()->_P.get(v);
+	deQuaternion& q = getVarFree()->_Q;
+	v[3] = q[0]; v[4] = q[1]; v[5] = q[2]; v[6] = q[3];
+}
+
+// the spatial DOF live in the child frame, so the increments of
+// position and orientation get rotated into the parent frame first
+void taoJointFree::addQdelta()
+{
+	deVector3 dp, dw;
+	dp.multiply(getVarFree()->_Q, getVarFree()->_ddQ[0]);
+	getVarFree()->_P += dp;
+
+	deQuaternion dq;
+	dw.multiply(getVarFree()->_Q, getVarFree()->_ddQ[1]);
+	dq.velocity(getVarFree()->_Q, dw);
+	getVarFree()->_Q += dq;
+	getVarFree()->_Q.normalize();
+}
+
+void taoJointFree::addDQdelta()
+{
+	getVarFree()->_dQ += getVarFree()->_ddQ;
+
+	if (getDQclamp()) 
+		clampDQ();
+}
+
+void taoJointFree::clampDQ()
+{
+	for (deInt i = 0; i < 6; i++)
+		if (getVarFree()->_dQ.elementAt(i) > getDQmax())
+			getVarFree()->_dQ.elementAt(i) = getDQmax();
+		else if (getVarFree()->_dQ.elementAt(i) < -getDQmax())
+			getVarFree()->_dQ.elementAt(i) = -getDQmax();
+}
+
+void taoJointFree::integrate(const deFloat dt)
+{
+	deVector3 dp, dw;
+	dp.multiply(getVarFree()->_Q, getVarFree()->_dQ[0]);
+	dp *= dt;
+	getVarFree()->_P += dp;
+
+	deQuaternion dq;
+	dw.multiply(getVarFree()->_Q, getVarFree()->_dQ[1]);
+	dq.velocity(getVarFree()->_Q, dw);
+	dq *= dt;
+	getVarFree()->_Q += dq;
+	getVarFree()->_Q.normalize();
+
+	deVector6 ddq;
+	ddq.multiply(getVarFree()->_ddQ, dt);
+	getVarFree()->_dQ += ddq;
+
+	if (getDQclamp()) 
+		clampDQ();
+}
+
+void taoJointFree::getJgColumns(deVector6 * Jg_columns) const
+{
+  deMatrix6 const & Jg(((taoABJointFree*)getABJoint())->Jg());
+  for (deInt icol(0); icol < 6; ++icol)
+    for (deInt irow(0); irow < 6; ++irow)
+      Jg_columns[icol].elementAt(irow) = Jg.elementAt(irow, icol);
+}
+
 deVector6& taoJointDOF1::getJg() const
 {
 	return ((taoABJointDOF1*)getABJoint())->Jg();
@@ -45,6 +45,10 @@ public:
 	virtual ~taoJoint();
 
 	virtual deInt getDOF() = 0;
+	/** Number of position coordinates, as used by setQ() and
+	    getQ(). This differs from getDOF() for joints that store
+	    their orientation as a quaternion. */
+	virtual deInt getQDim() { return getDOF(); }
 	virtual void reset() = 0;
 
 	virtual void setDVar(taoDVar* var) { _var = var; }
@@ -148,6 +152,7 @@ public:
 	taoJointSpherical();
 
 	virtual deInt getDOF() { return 3; }
+	virtual deInt getQDim() { return 4; }
 	virtual void reset();
 
 	virtual taoVarSpherical* getVarSpherical() { return (taoVarSpherical*)getDVar(); }
@@ -219,6 +224,57 @@ public:
   
 };
 
+/*!
+ *	\brief		Free-flyer joint class for articulated body
+ *	\ingroup	taoDynamics
+ *
+ *	This provides a 6-DOF joint for floating bases. The position
+ *	has seven coordinates: the translation (x, y, z) followed by the
+ *	orientation quaternion (x, y, z, w). The six velocity DOF are
+ *	the linear and angular velocity of the child expressed in the
+ *	child frame, and likewise for accelerations and forces.
+ *	\sa	taoJoint
+ */
+class taoJointFree : public taoJoint
+{
+public:
+	taoJointFree();
+
+	virtual deInt getDOF() { return 6; }
+	virtual deInt getQDim() { return 7; }
+	virtual void reset();
+
+	virtual taoVarFree* getVarFree() { return (taoVarFree*)getDVar(); }
+
+	virtual void addQdelta();
+	virtual void addDQdelta();
+	virtual void zeroTau() { getVarFree()->_Tau.zero(); }
+	virtual void zeroDDQ() { getVarFree()->_ddQ.zero(); }
+	virtual void zeroDQ() { getVarFree()->_dQ.zero(); }
+	virtual void zeroQ() { getVarFree()->_P.zero(); getVarFree()->_Q.identity(); }
+	virtual void setTau(const deFloat* v) { getVarFree()->_Tau[0].set(v); getVarFree()->_Tau[1].set(v + 3); }
+	virtual void setDDQ(const deFloat* v) { getVarFree()->_ddQ[0].set(v); getVarFree()->_ddQ[1].set(v + 3); }
+	virtual void setDQ(const deFloat* v) { getVarFree()->_dQ[0].set(v); getVarFree()->_dQ[1].set(v + 3); }
+	virtual void setQ(const deFloat* v) { getVarFree()->_P.set(v); getVarFree()->_Q.set(v + 3); }
+	virtual void getTau(deFloat* v) { getVarFree()->_Tau[0].get(v); getVarFree()->_Tau[1].get(v + 3); }
+	virtual void getDDQ(deFloat* v) { getVarFree()->_ddQ[0].get(v); getVarFree()->_ddQ[1].get(v + 3); }
+	virtual void getDQ(deFloat* v) { getVarFree()->_dQ[0].get(v); getVarFree()->_dQ[1].get(v + 3); }
+	virtual void getQ(deFloat* v);
+
+	virtual void clampDQ();
+	virtual void integrate(const deFloat dt);
+	virtual void updateFrameLocal(deFrame* local)
+	{
+		local->rotation() = getVarFree()->_Q;
+		local->translation() = getVarFree()->_P;
+	}
+
+  /** You need to pass in an array of six deVector6 instances, one
+      per velocity DOF. */
+  virtual void getJgColumns(deVector6 * Jg_columns) const;
+  
+};
+
 /*!
  *	\brief		1 DOF joint class for articulated body
  *	\ingroup	taoDynamics
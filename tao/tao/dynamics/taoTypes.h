@@ -29,7 +29,7 @@
 //#define TAO_CONTROL
 
 typedef enum {TAO_AXIS_X = 0, TAO_AXIS_Y = 1, TAO_AXIS_Z = 2, TAO_AXIS_S = 3, TAO_AXIS_USER = 4} taoAxis;
-typedef enum {TAO_JOINT_PRISMATIC, TAO_JOINT_REVOLUTE, TAO_JOINT_SPHERICAL, TAO_JOINT_USER} taoJointType;
+typedef enum {TAO_JOINT_PRISMATIC, TAO_JOINT_REVOLUTE, TAO_JOINT_SPHERICAL, TAO_JOINT_USER, TAO_JOINT_FREE} taoJointType;
 #ifdef TAO_CONTROL
 typedef enum {TAO_CONTROL_ZERO, TAO_CONTROL_FLOAT, TAO_CONTROL_PD, TAO_CONTROL_GOALPOSITION} taoControlType;
 #endif
@@ -62,4 +62,22 @@ public:
 	deVector3 _dQrotated;	//!<	joint velocity in reference (parent) frame
 };
 
+/*!
+ *	\brief free-flyer joint variable class for articulated body
+ *	\ingroup taoDynamics
+ *
+ *	This provides joint variables necessary for articulated body dynamics.
+ *	Velocities, accelerations, and forces are spatial vectors
+ *	[linear; angular] expressed in the local (child) frame.
+ */
+class taoVarFree : public taoDVar
+{
+public:
+	deVector3 _P;			//!<	joint position, translational part
+	deQuaternion _Q;		//!<	joint position, rotational part
+	deVector6 _dQ;			//!<	joint velocity in local frame
+	deVector6 _ddQ;			//!<	joint acceleration
+	deVector6 _Tau;			//!<	joint force (wrench)
+};
+
 #endif // _taoVar_h
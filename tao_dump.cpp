@@ -172,13 +172,14 @@ namespace std {
       break;
     case TAO_JOINT_SPHERICAL: os << "spherical "; break;
     case TAO_JOINT_USER:      os << "user "; break;
+    case TAO_JOINT_FREE:      os << "free "; break;
     default:                  os << "<invalid type: " << jtype << "> ";
     }
     os << "  " << joint.getDOF() << " DOF";
-    std::vector<deFloat> foo(joint.getDOF());
+    std::vector<deFloat> foo(joint.getQDim());
     joint.getQ(&foo[0]);
     os << "  q: ";
-    dump_deFloat(os, &foo[0], joint.getDOF());
+    dump_deFloat(os, &foo[0], joint.getQDim());
     joint.getDQ(&foo[0]);
     os << "  dq: ";
     dump_deFloat(os, &foo[0], joint.getDOF());
@@ -28,6 +28,7 @@
 #include <tao/dynamics/taoNode.h>
 #include <tao/dynamics/taoDNode.h>
 #include <tao/dynamics/taoJoint.h>
+#include <tao/utility/TaoDeMassProp.h>
 
 #include <stdexcept>
 
@@ -132,4 +133,122 @@ namespace minitao {
     }
   }
   
+  
+  void mergeMassProperties(taoDNode * host,
+			   taoDNode * node,
+			   bool remove)
+  {
+    deFrame const & home(*node->frameHome());
+    deFloat const mass(*node->mass());
+    deVector3 const & center(*node->center());
+    
+    // TAO nodes store their inertia about the node origin, whereas
+    // deMassProp::inertia() expects it about the center of mass and
+    // deMassProp::mass() adds the parallel-axis term back in.
+    deMatrix3 com_inertia;
+    com_inertia = *node->inertia();
+    deFloat const c2(center.dot(center));
+    for (int ii(0); ii < 3; ++ii) {
+      for (int jj(0); jj < 3; ++jj) {
+	com_inertia[ii][jj] -= mass * (((ii == jj) ? c2 : 0) - center[ii] * center[jj]);
+      }
+    }
+    
+    // The contribution of the node, about the origin of the host.
+    deMassProp contribution;
+    contribution.inertia(&com_inertia, &home);
+    if (mass > 0) {
+      deFrame com_frame;
+      com_frame.identity();
+      com_frame.translation().multiply(home, center);
+      contribution.mass(mass, &com_frame);
+    }
+    
+    deFloat const sign(remove ? -1 : 1);
+    deFloat const total(*host->mass() + sign * mass);
+    deVector3 moment, node_moment;
+    moment.multiply(*host->center(), *host->mass());
+    node_moment.multiply(*contribution.center(), sign * mass);
+    moment += node_moment;
+    if (total > 0) {
+      host->center()->multiply(moment, 1 / total);
+      *host->mass() = total;
+    }
+    else {
+      host->center()->zero();
+      *host->mass() = 0;
+    }
+    for (int ii(0); ii < 3; ++ii) {
+      for (int jj(0); jj < 3; ++jj) {
+	(*host->inertia())[ii][jj] += sign * (*contribution.inertia())[ii][jj];
+      }
+    }
+  }
+  
+  
+  static size_t fuseChildren(nodeVector_t & fused,
+			     taoDNode * node)
+  {
+    // All nodes below the root are taoNode instances, and only those
+    // allow to set the parent and sibling pointers.
+    size_t count(0);
+    taoNode * previous(0);
+    taoNode * child(static_cast<taoNode*>(node->getDChild()));
+    while (0 != child) {
+      if (0 != child->getJointList()) {
+	count += fuseChildren(fused, child);
+	previous = child;
+	child = static_cast<taoNode*>(child->getDSibling());
+	continue;
+      }
+      
+      // The root does not move, so whatever is attached to it does
+      // not contribute to the dynamics.
+      if ( ! node->isRoot()) {
+	mergeMassProperties(node, child, false);
+      }
+      
+      // Splice the grandchildren into the sibling list in place of
+      // the merged child. They get visited next, because they might
+      // be jointless as well.
+      taoNode * first(static_cast<taoNode*>(child->getDChild()));
+      taoNode * last(0);
+      for (taoNode * grandchild(first); 0 != grandchild;
+	   grandchild = static_cast<taoNode*>(grandchild->getDSibling())) {
+	deFrame home;
+	home.multiply(*child->frameHome(), *grandchild->frameHome());
+	*grandchild->frameHome() = home;
+	grandchild->setDParent(node);
+	last = grandchild;
+      }
+      taoNode * const next(static_cast<taoNode*>(child->getDSibling()));
+      if (0 != last) {
+	last->setDSibling(next);
+      }
+      else {
+	first = next;
+      }
+      if (0 != previous) {
+	previous->setDSibling(first);
+      }
+      else {
+	node->setDChild(first);
+      }
+      
+      child->setDChild(0);
+      child->setDSibling(0);
+      fused.push_back(child);
+      ++count;
+      child = first;
+    }
+    return count;
+  }
+  
+  
+  size_t fuseFixedNodes(nodeVector_t & fused,
+			taoDNode * root)
+  {
+    return fuseChildren(fused, root);
+  }
+  
 }
@@ -111,6 +111,46 @@ namespace minitao {
   */
   double computeTotalMass(taoDNode * node);
   
+  
+  /**
+     Add the mass properties of a node to those of another one,
+     usually its parent, or remove them again. The home frame of the
+     node has to be its offset from the other node, as is the case
+     for the nodes merged by fuseFixedNodes().
+     
+     \note The ABNode of the host is not updated, call
+     taoABDynamics::resetInertia() on it afterwards.
+  */
+  void mergeMassProperties(taoDNode * host,
+			   taoDNode * node,
+			   bool remove);
+  
+  
+  /**
+     Merge every node without joints into its parent, such that each
+     rigid body of the tree ends up as a single node. The mass
+     properties of a merged node are added to those of its parent,
+     and its children take its place among the children of the
+     parent (keeping their order, with the home frame of the merged
+     node composed into theirs). The mass properties of jointless
+     children of the root passed as argument are dropped, because
+     the root does not take part in the dynamics.
+     
+     The merged nodes are unlinked but not deleted. They are appended
+     to the \c fused vector, with their parent set to the node that
+     now carries their mass and their home frame set to their offset
+     from it, such that updateFrame() still yields their global
+     frame. The caller has to delete them.
+     
+     \note Call taoDynamics::initialize() on the root afterwards, in
+     order to propagate the new home frames and mass properties to
+     the articulated-body nodes.
+     
+     \return The number of merged nodes.
+  */
+  size_t fuseFixedNodes(nodeVector_t & fused,
+			taoDNode * root);
+  
 }
 
 #endif // MINITAO_TAO_UTIL_H
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <stdexcept>
 
@@ -38,6 +39,24 @@ using namespace minitao::test;
 using namespace std;
 
 
+// Parse a model from a temporary XML file, which gets removed
+// afterwards.
+static BranchingRepresentation * parse_tmpfile(std::string const & xml_filename)
+{
+  BRParser brp;
+  BranchingRepresentation * brep(0);
+  try {
+    brep = brp.parse(xml_filename);
+  }
+  catch (...) {
+    unlink(xml_filename.c_str());
+    throw;
+  }
+  unlink(xml_filename.c_str());
+  return brep;
+}
+
+
 static std::string create_puma_xml()
 {
   static char const * xml = 
@@ -155,13 +174,7 @@ static std::string create_puma_xml()
 
 static BranchingRepresentation * create_puma_brep()
 {
-  static string xml_filename("");
-  if (xml_filename.empty()) {
-    xml_filename = create_puma_xml();
-  }
-  BRParser brp;
-  BranchingRepresentation * brep(brp.parse(xml_filename));
-  return brep;
+  return parse_tmpfile(create_puma_xml());
 }
 
 namespace minitao {
@@ -219,13 +232,7 @@ static std::string create_unit_mass_RR_xml()
 
 static BranchingRepresentation * create_unit_mass_RR_brep()
 {
-  static string xml_filename("");
-  if (xml_filename.empty()) {
-    xml_filename = create_unit_mass_RR_xml();
-  }
-  BRParser brp;
-  BranchingRepresentation * brep(brp.parse(xml_filename));
-  return brep;
+  return parse_tmpfile(create_unit_mass_RR_xml());
 }
 
 
@@ -317,13 +324,7 @@ namespace minitao {
     
     BranchingRepresentation * create_unit_mass_5R_brep()
     {
-      static string xml_filename("");
-      if (xml_filename.empty()) {
-	xml_filename = create_unit_mass_5R_xml();
-      }
-      BRParser brp;
-      BranchingRepresentation * brep(brp.parse(xml_filename));
-      return brep;
+      return parse_tmpfile(create_unit_mass_5R_xml());
     }
     
     
@@ -379,13 +380,7 @@ static std::string create_unit_inertia_RR_xml()
 
 static BranchingRepresentation * create_unit_inertia_RR_brep()
 {
-  static string xml_filename("");
-  if (xml_filename.empty()) {
-    xml_filename = create_unit_inertia_RR_xml();
-  }
-  BRParser brp;
-  BranchingRepresentation * brep(brp.parse(xml_filename));
-  return brep;
+  return parse_tmpfile(create_unit_inertia_RR_xml());
 }
 
 
@@ -444,13 +439,7 @@ static std::string create_unit_mass_RP_xml()
 
 static BranchingRepresentation * create_unit_mass_RP_brep()
 {
-  static string xml_filename("");
-  if (xml_filename.empty()) {
-    xml_filename = create_unit_mass_RP_xml();
-  }
-  BRParser brp;
-  BranchingRepresentation * brep(brp.parse(xml_filename));
-  return brep;
+  return parse_tmpfile(create_unit_mass_RP_xml());
 }
 
 
@@ -469,3 +458,359 @@ namespace minitao {
 
   }
 }
+
+
+static std::string create_branching_xml()
+{
+  static char const * xml = 
+    "<?xml version=\"1.0\" ?>\n"
+    "<dynworld>\n"
+    "  <baseNode>\n"
+    "    <gravity>0, 0, -9.81</gravity>\n"
+    "    <pos>0, 0, 0</pos>\n"
+    "    <rot>1, 0, 0, 0</rot>\n"
+    "    <jointNode>\n"
+    "      <ID>0</ID>\n"
+    "      <type>R</type>\n"
+    "      <axis>Z</axis>\n"
+    "      <mass>3</mass>\n"
+    "      <inertia>0.1, 0.2, 0.3</inertia>\n"
+    "      <com>0, 0, 0.5</com>\n"
+    "      <pos>0, 0, 0</pos>\n"
+    "      <rot>1, 0, 0, 0</rot>\n"
+    "      <jointNode>\n"
+    "        <ID>4</ID>\n"
+    "        <type>R</type>\n"
+    "        <axis>Y</axis>\n"
+    "        <mass>1</mass>\n"
+    "        <inertia>0.05, 0.05, 0.01</inertia>\n"
+    "        <com>0.5, 0, 0</com>\n"
+    "        <pos>0, 0.3, 1</pos>\n"
+    "        <rot>1, 0, 0, 0</rot>\n"
+    "        <jointNode>\n"
+    "          <ID>5</ID>\n"
+    "          <type>R</type>\n"
+    "          <axis>X</axis>\n"
+    "          <mass>0.8</mass>\n"
+    "          <inertia>0.02, 0.03, 0.03</inertia>\n"
+    "          <com>0.4, 0, 0</com>\n"
+    "          <pos>1, 0, 0</pos>\n"
+    "          <rot>0, 0, 1, 0.4</rot>\n"
+    "        </jointNode>\n"
+    "      </jointNode>\n"
+    "      <jointNode>\n"
+    "        <ID>1</ID>\n"
+    "        <type>R</type>\n"
+    "        <axis>X</axis>\n"
+    "        <mass>1.2</mass>\n"
+    "        <inertia>0.06, 0.02, 0.06</inertia>\n"
+    "        <com>0, -0.5, 0</com>\n"
+    "        <pos>0, -0.3, 1</pos>\n"
+    "        <rot>0, 0, 1, 0.3</rot>\n"
+    "        <jointNode>\n"
+    "          <ID>2</ID>\n"
+    "          <type>P</type>\n"
+    "          <axis>Z</axis>\n"
+    "          <mass>0.7</mass>\n"
+    "          <inertia>0.01, 0.01, 0.02</inertia>\n"
+    "          <com>0, 0, 0.2</com>\n"
+    "          <pos>0, -1, 0</pos>\n"
+    "          <rot>1, 0, 0, 0</rot>\n"
+    "          <jointNode>\n"
+    "            <ID>3</ID>\n"
+    "            <type>R</type>\n"
+    "            <axis>Y</axis>\n"
+    "            <mass>0.4</mass>\n"
+    "            <inertia>0.01, 0.02, 0.01</inertia>\n"
+    "            <com>0.1, 0.1, 0</com>\n"
+    "            <pos>0, 0, 0.5</pos>\n"
+    "            <rot>1, 0, 0, 0</rot>\n"
+    "          </jointNode>\n"
+    "        </jointNode>\n"
+    "      </jointNode>\n"
+    "    </jointNode>\n"
+    "  </baseNode>\n"
+    "</dynworld>\n";
+  std::string result(create_tmpfile("branching.xml.XXXXXX", xml));
+  return result;
+}
+
+
+static BranchingRepresentation * create_branching_brep()
+{
+  return parse_tmpfile(create_branching_xml());
+}
+
+
+namespace minitao {
+  namespace test {
+    
+    minitao::Model * create_branching_model()
+    {
+      BranchingRepresentation * kg_brep(create_branching_brep());
+      BranchingRepresentation * cc_brep(create_branching_brep());
+      minitao::Model * model(new minitao::Model(kg_brep->rootNode(), cc_brep->rootNode()));
+      delete kg_brep;
+      delete cc_brep;
+      return model;
+    }
+
+  }
+}
+
+
+static std::string create_free_flyer_xml()
+{
+  static char const * xml = 
+    "<?xml version=\"1.0\" ?>\n"
+    "<dynworld>\n"
+    "  <baseNode>\n"
+    "    <gravity>0, 0, -9.81</gravity>\n"
+    "    <pos>0, 0, 0</pos>\n"
+    "    <rot>1, 0, 0, 0</rot>\n"
+    "    <jointNode>\n"
+    "      <ID>0</ID>\n"
+    "      <type>F</type>\n"
+    "      <axis>Z</axis>\n"
+    "      <mass>4</mass>\n"
+    "      <inertia>0.2, 0.3, 0.4</inertia>\n"
+    "      <com>0.05, -0.02, 0.1</com>\n"
+    "      <pos>0, 0, 1</pos>\n"
+    "      <rot>1, 0, 0, 0</rot>\n"
+    "      <jointNode>\n"
+    "        <ID>1</ID>\n"
+    "        <type>R</type>\n"
+    "        <axis>Y</axis>\n"
+    "        <mass>1</mass>\n"
+    "        <inertia>0.05, 0.05, 0.01</inertia>\n"
+    "        <com>0, 0, -0.3</com>\n"
+    "        <pos>0.2, 0.1, -0.1</pos>\n"
+    "        <rot>1, 0, 0, 0</rot>\n"
+    "        <jointNode>\n"
+    "          <ID>2</ID>\n"
+    "          <type>P</type>\n"
+    "          <axis>Z</axis>\n"
+    "          <mass>0.5</mass>\n"
+    "          <inertia>0.01, 0.01, 0.02</inertia>\n"
+    "          <com>0, 0, -0.1</com>\n"
+    "          <pos>0, 0, -0.6</pos>\n"
+    "          <rot>1, 0, 0, 0</rot>\n"
+    "        </jointNode>\n"
+    "      </jointNode>\n"
+    "      <jointNode>\n"
+    "        <ID>3</ID>\n"
+    "        <type>R</type>\n"
+    "        <axis>X</axis>\n"
+    "        <mass>0.8</mass>\n"
+    "        <inertia>0.02, 0.03, 0.03</inertia>\n"
+    "        <com>0, -0.4, 0</com>\n"
+    "        <pos>-0.2, -0.1, 0</pos>\n"
+    "        <rot>0, 0, 1, 0.3</rot>\n"
+    "      </jointNode>\n"
+    "    </jointNode>\n"
+    "  </baseNode>\n"
+    "</dynworld>\n";
+  std::string result(create_tmpfile("free_flyer.xml.XXXXXX", xml));
+  return result;
+}
+
+
+static BranchingRepresentation * create_free_flyer_brep()
+{
+  return parse_tmpfile(create_free_flyer_xml());
+}
+
+
+namespace minitao {
+  namespace test {
+    
+    minitao::Model * create_free_flyer_model()
+    {
+      BranchingRepresentation * kg_brep(create_free_flyer_brep());
+      BranchingRepresentation * cc_brep(create_free_flyer_brep());
+      minitao::Model * model(new minitao::Model(kg_brep->rootNode(), cc_brep->rootNode()));
+      delete kg_brep;
+      delete cc_brep;
+      return model;
+    }
+
+  }
+}
+
+
+static std::string create_spherical_xml()
+{
+  static char const * xml = 
+    "<?xml version=\"1.0\" ?>\n"
+    "<dynworld>\n"
+    "  <baseNode>\n"
+    "    <gravity>0, 0, -9.81</gravity>\n"
+    "    <pos>0, 0, 0</pos>\n"
+    "    <rot>1, 0, 0, 0</rot>\n"
+    "    <jointNode>\n"
+    "      <ID>0</ID>\n"
+    "      <type>F</type>\n"
+    "      <axis>Z</axis>\n"
+    "      <mass>5</mass>\n"
+    "      <inertia>0.3, 0.2, 0.4</inertia>\n"
+    "      <com>-0.03, 0.02, 0.1</com>\n"
+    "      <pos>0, 0, 1</pos>\n"
+    "      <rot>1, 0, 0, 0</rot>\n"
+    "      <jointNode>\n"
+    "        <ID>1</ID>\n"
+    "        <type>S</type>\n"
+    "        <axis>Z</axis>\n"
+    "        <mass>1.2</mass>\n"
+    "        <inertia>0.06, 0.05, 0.01</inertia>\n"
+    "        <com>0.02, 0, -0.25</com>\n"
+    "        <pos>0.1, -0.15, -0.1</pos>\n"
+    "        <rot>1, 0, 0, 0.2</rot>\n"
+    "        <jointNode>\n"
+    "          <ID>2</ID>\n"
+    "          <type>R</type>\n"
+    "          <axis>Y</axis>\n"
+    "          <mass>0.7</mass>\n"
+    "          <inertia>0.03, 0.03, 0.005</inertia>\n"
+    "          <com>0, 0.01, -0.2</com>\n"
+    "          <pos>0, 0, -0.5</pos>\n"
+    "          <rot>1, 0, 0, 0</rot>\n"
+    "        </jointNode>\n"
+    "      </jointNode>\n"
+    "      <jointNode>\n"
+    "        <ID>3</ID>\n"
+    "        <type>S</type>\n"
+    "        <axis>Z</axis>\n"
+    "        <mass>0.6</mass>\n"
+    "        <inertia>0.02, 0.01, 0.02</inertia>\n"
+    "        <com>0, 0.3, 0.02</com>\n"
+    "        <pos>0, 0.2, 0.4</pos>\n"
+    "        <rot>0, 1, 0, -0.4</rot>\n"
+    "      </jointNode>\n"
+    "    </jointNode>\n"
+    "  </baseNode>\n"
+    "</dynworld>\n";
+  std::string result(create_tmpfile("spherical.xml.XXXXXX", xml));
+  return result;
+}
+
+
+static BranchingRepresentation * create_spherical_brep()
+{
+  return parse_tmpfile(create_spherical_xml());
+}
+
+
+namespace minitao {
+  namespace test {
+    
+    minitao::Model * create_spherical_model()
+    {
+      BranchingRepresentation * kg_brep(create_spherical_brep());
+      BranchingRepresentation * cc_brep(create_spherical_brep());
+      minitao::Model * model(new minitao::Model(kg_brep->rootNode(), cc_brep->rootNode()));
+      delete kg_brep;
+      delete cc_brep;
+      return model;
+    }
+
+  }
+}
+
+
+static std::string create_fixed_link_xml()
+{
+  static char const * xml = 
+    "<?xml version=\"1.0\" ?>\n"
+    "<dynworld>\n"
+    "  <baseNode>\n"
+    "    <gravity>0, 0, -9.81</gravity>\n"
+    "    <pos>0, 0, 0</pos>\n"
+    "    <rot>1, 0, 0, 0</rot>\n"
+    "    <jointNode>\n"
+    "      <ID>0</ID>\n"
+    "      <type>R</type>\n"
+    "      <axis>Z</axis>\n"
+    "      <mass>2</mass>\n"
+    "      <inertia>0.1, 0.1, 0.05</inertia>\n"
+    "      <com>0.02, 0, 0.15</com>\n"
+    "      <pos>0, 0, 0.5</pos>\n"
+    "      <rot>1, 0, 0, 0</rot>\n"
+    "      <jointNode>\n"
+    "        <ID>1</ID>\n"
+    "        <type>X</type>\n"
+    "        <axis>Z</axis>\n"
+    "        <mass>0.8</mass>\n"
+    "        <inertia>0.01, 0.02, 0.015</inertia>\n"
+    "        <com>0.05, -0.02, 0.03</com>\n"
+    "        <pos>0.1, 0.05, 0.3</pos>\n"
+    "        <rot>0.6, 0.8, 0, 0.6</rot>\n"
+    "        <jointNode>\n"
+    "          <ID>2</ID>\n"
+    "          <type>X</type>\n"
+    "          <axis>Z</axis>\n"
+    "          <mass>0.3</mass>\n"
+    "          <inertia>0.002, 0.001, 0.003</inertia>\n"
+    "          <com>0, 0.01, 0.02</com>\n"
+    "          <pos>-0.05, 0.1, 0.02</pos>\n"
+    "          <rot>0, 0, 1, -0.9</rot>\n"
+    "        </jointNode>\n"
+    "        <jointNode>\n"
+    "          <ID>3</ID>\n"
+    "          <type>R</type>\n"
+    "          <axis>Y</axis>\n"
+    "          <mass>1.1</mass>\n"
+    "          <inertia>0.04, 0.01, 0.04</inertia>\n"
+    "          <com>0.2, 0, 0.01</com>\n"
+    "          <pos>0.15, 0, 0.1</pos>\n"
+    "          <rot>0, 0.6, 0.8, 0.3</rot>\n"
+    "          <jointNode>\n"
+    "            <ID>5</ID>\n"
+    "            <type>X</type>\n"
+    "            <axis>Z</axis>\n"
+    "            <mass>0.4</mass>\n"
+    "            <inertia>0.003, 0.004, 0.002</inertia>\n"
+    "            <com>0.03, 0.01, -0.02</com>\n"
+    "            <pos>0.4, 0, 0</pos>\n"
+    "            <rot>1, 0, 0, 1.2</rot>\n"
+    "          </jointNode>\n"
+    "        </jointNode>\n"
+    "      </jointNode>\n"
+    "      <jointNode>\n"
+    "        <ID>4</ID>\n"
+    "        <type>P</type>\n"
+    "        <axis>X</axis>\n"
+    "        <mass>0.9</mass>\n"
+    "        <inertia>0.01, 0.03, 0.03</inertia>\n"
+    "        <com>0.1, 0.02, 0</com>\n"
+    "        <pos>0, -0.1, 0.2</pos>\n"
+    "        <rot>0, 0, 1, 0.5</rot>\n"
+    "      </jointNode>\n"
+    "    </jointNode>\n"
+    "  </baseNode>\n"
+    "</dynworld>\n";
+  std::string result(create_tmpfile("fixed_link.xml.XXXXXX", xml));
+  return result;
+}
+
+
+namespace minitao {
+  namespace test {
+    
+    BranchingRepresentation * create_fixed_link_brep()
+    {
+      return parse_tmpfile(create_fixed_link_xml());
+    }
+    
+    
+    minitao::Model * create_fixed_link_model()
+    {
+      BranchingRepresentation * kg_brep(create_fixed_link_brep());
+      BranchingRepresentation * cc_brep(create_fixed_link_brep());
+      minitao::Model * model(new minitao::Model(kg_brep->rootNode(), cc_brep->rootNode()));
+      delete kg_brep;
+      delete cc_brep;
+      return model;
+    }
+
+  }
+}
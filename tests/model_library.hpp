@@ -36,6 +36,32 @@ namespace minitao {
     minitao::Model * create_unit_mass_5R_model();
     minitao::Model * create_unit_inertia_RR_model();
     minitao::Model * create_unit_mass_RP_model();
+    
+    /** A trunk with two arms, one of which contains a prismatic
+	joint, for testing cross-coupling between branches. The node
+	IDs match the DOF indices. */
+    minitao::Model * create_branching_model();
+    
+    /** A floating base with a free-flyer joint (node ID 0, six DOF,
+	seven position coordinates) that carries a revolute-prismatic
+	leg (IDs 1 and 2) and a revolute arm (ID 3). */
+    minitao::Model * create_free_flyer_model();
+    
+    /** A floating base (node ID 0) with a spherical hip (ID 1) that
+	carries a revolute knee (ID 2), and a spherical shoulder (ID
+	3). This gives 13 DOF and 16 position coordinates. The TAO
+	tree lists the shoulder before the hip, so the DOF are ordered
+	base, shoulder, hip, knee. */
+    minitao::Model * create_spherical_model();
+    
+    /** A revolute base (node ID 0) and a prismatic slider (ID 4),
+	plus a flange (ID 1) that is rigidly attached to the base and
+	carries a sensor (ID 2, rigidly attached to the flange) and a
+	revolute elbow (ID 3) with a rigidly attached tool (ID
+	5). The Model merges IDs 1, 2, and 5 into their parents,
+	leaving three nodes with one DOF each. */
+    BranchingRepresentation * create_fixed_link_brep();
+    minitao::Model * create_fixed_link_model();
 
   }
 }
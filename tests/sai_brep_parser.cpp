@@ -241,9 +241,11 @@ namespace minitao {
 	  case 'p': case 'P': type_ = 'p'; break;
 	  case 'r': case 'R': type_ = 'r'; break;
 	  case 's': case 'S': type_ = 's'; break;
+	  case 'f': case 'F': type_ = 'f'; break;
+	  case 'x': case 'X': type_ = 'x'; break;
 	  default:
 	    throw std::runtime_error("minitao::test::BRParser::exploreJointNode(): invalid <type> `"
-				     + typeJoint + "' (should be P, R, or S)");
+				     + typeJoint + "' (should be P, R, S, F, or X for fixed)");
 	  }
 	}
 
@@ -370,6 +372,13 @@ namespace minitao {
 	joint = new taoJointSpherical();
 	joint->setDVar(new taoVarSpherical); //?
 	break;
+      case 'f':
+	joint = new taoJointFree();
+	joint->setDVar(new taoVarFree);
+	break;
+      case 'x':
+	// fixed: the node simply gets no joint
+	break;
       default:
 	// Should probably throw an exception or so, I do not believe we
 	// actually support custom joint types... but I also think it
@@ -377,11 +386,12 @@ namespace minitao {
 	break;
       }
 
-      joint->reset();
-      joint->setDamping(0.0);
-      joint->setInertia(0.0);
-
-      new_child_node->addJoint(joint); 
+      if (joint) {
+	joint->reset();
+	joint->setDamping(0.0);
+	joint->setInertia(0.0);
+	new_child_node->addJoint(joint); 
+      }
 
       new_child_node->addABNode();
 
@@ -61,7 +61,7 @@ namespace minitao {
       int opID_;
       
       // /** \todo Probably unused... kick out please. */
-      char type_;			// 'p', 'r', or 's'
+      char type_;			// 'p', 'r', 's', or 'f'
       char axis_;			// 'x', 'y', or 'z'
       deFloat mass_;
       deVector3 inertia_;
@@ -26,17 +26,23 @@
 #include "model_library.hpp"
 #include "util.hpp"
 #include "sai_brep_parser.hpp"
+#include "sai_brep.hpp"
 #include "strutil.hpp"
 #include "tao_dump.hpp"
 #include "vector_util.hpp"
+#include "codegen.hpp"
+#include "CompiledModel.hpp"
+#include "ParameterEstimator.hpp"
 #include <tao/dynamics/taoNode.h>
 #include <tao/dynamics/taoDynamics.h>
 #include <tao/dynamics/taoJoint.h>
+#include <tao/utility/TaoDeMassProp.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <gtest/gtest.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include <Eigen/SVD>
 #include <Eigen/LU>
@@ -108,6 +114,7 @@ TEST (jspaceModel, kinematics)
     
     string const frames_filename(create_puma_frames());
     ifstream is(frames_filename.c_str());
+    unlink(frames_filename.c_str());	// the stream keeps it open
 
     string line;
     int joint_positions_count(0);
@@ -759,6 +766,2538 @@ TEST (jspaceModel, mass_inertia_RP)
   }
   delete model;
 }
+static minitao::Vector model_inverse_dynamics(minitao::Model * model,
+					      minitao::State const & state,
+					      minitao::Vector const & acceleration)
+{
+  model->update(state);
+  minitao::Vector gg, bb;
+  minitao::Matrix AA;
+  model->getGravity(gg);
+  model->getCoriolisCentrifugal(bb);
+  model->getMassInertia(AA);
+  return AA * acceleration + bb + gg;
+}
+
+
+static minitao::Vector model_forward_dynamics(minitao::Model * model,
+					      minitao::State const & state,
+					      minitao::Vector const & tau)
+{
+  model->update(state);
+  minitao::Vector gg, bb;
+  minitao::Matrix Ainv;
+  model->getGravity(gg);
+  model->getCoriolisCentrifugal(bb);
+  model->getInverseMassInertia(Ainv);
+  return Ainv * (tau - bb - gg);
+}
+
+
+TEST (jspaceModel, dynamics_derivatives)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    minitao::Vector acceleration(ndof), tau(ndof);
+    double const step(1e-5);
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	acceleration[ii] = 0.5 * sin(0.4 * iteration + 1.9 * ii);
+	tau[ii] = 10 * cos(0.7 * iteration + 0.3 * ii);
+      }
+      
+      minitao::Matrix id_dpos_check(ndof, ndof), id_dvel_check(ndof, ndof);
+      minitao::Matrix fd_dpos_check(ndof, ndof), fd_dvel_check(ndof, ndof);
+      for (size_t jj(0); jj < ndof; ++jj) {
+	minitao::State plus(state), minus(state);
+	plus.position_[jj] += step;
+	minus.position_[jj] -= step;
+	id_dpos_check.col(jj) = (model_inverse_dynamics(model, plus, acceleration)
+				 - model_inverse_dynamics(model, minus, acceleration)) / (2 * step);
+	fd_dpos_check.col(jj) = (model_forward_dynamics(model, plus, tau)
+				 - model_forward_dynamics(model, minus, tau)) / (2 * step);
+	plus = state;
+	minus = state;
+	plus.velocity_[jj] += step;
+	minus.velocity_[jj] -= step;
+	id_dvel_check.col(jj) = (model_inverse_dynamics(model, plus, acceleration)
+				 - model_inverse_dynamics(model, minus, acceleration)) / (2 * step);
+	fd_dvel_check.col(jj) = (model_forward_dynamics(model, plus, tau)
+				 - model_forward_dynamics(model, minus, tau)) / (2 * step);
+      }
+      
+      model->update(state);
+      minitao::Matrix dpos, dvel;
+      ASSERT_TRUE (model->computeInverseDynamicsDerivatives(acceleration, dpos, dvel));
+      {
+	std::ostringstream msg;
+	msg << "Checking inverse dynamics derivatives for q = " << state.position_ << "\n";
+	pretty_print(id_dpos_check, msg, "  want dtau_dposition", "    ");
+	pretty_print(dpos, msg, "  have dtau_dposition", "    ");
+	EXPECT_TRUE (check_matrix("dtau_dposition", id_dpos_check, dpos, 1e-3, msg)) << msg.str();
+	EXPECT_TRUE (check_matrix("dtau_dvelocity", id_dvel_check, dvel, 1e-3, msg)) << msg.str();
+      }
+      
+      ASSERT_TRUE (model->computeForwardDynamicsDerivatives(tau, dpos, dvel));
+      {
+	std::ostringstream msg;
+	msg << "Checking forward dynamics derivatives for q = " << state.position_ << "\n";
+	pretty_print(fd_dpos_check, msg, "  want dacc_dposition", "    ");
+	pretty_print(dpos, msg, "  have dacc_dposition", "    ");
+	EXPECT_TRUE (check_matrix("dacc_dposition", fd_dpos_check, dpos, 1e-3, msg)) << msg.str();
+	EXPECT_TRUE (check_matrix("dacc_dvelocity", fd_dvel_check, dvel, 1e-3, msg)) << msg.str();
+      }
+      
+      minitao::Vector const too_short(ndof - 1);
+      EXPECT_FALSE (model->computeInverseDynamicsDerivatives(too_short, dpos, dvel));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+TEST (jspaceModel, inverse_dynamics)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    taoDNode * ee(model->findNodeByID(ndof - 1));
+    ASSERT_NE ((void*)0, ee);
+    minitao::State state(ndof, ndof, 0);
+    minitao::Vector acceleration(ndof);
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	acceleration[ii] = 0.5 * sin(0.4 * iteration + 1.9 * ii);
+      }
+      minitao::Vector const tau_check(model_inverse_dynamics(model, state, acceleration));
+      minitao::Matrix AA_before;
+      model->getMassInertia(AA_before);
+      
+      minitao::Vector tau;
+      ASSERT_TRUE (model->computeInverseDynamics(acceleration, tau));
+      {
+	std::ostringstream msg;
+	msg << "Checking inverse dynamics for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_vector("tau", tau_check, tau, 1e-6, msg)) << msg.str();
+      }
+      
+      minitao::Transform ee_frame;
+      ASSERT_TRUE (model->computeGlobalFrame(ee, 0.1, -0.05, 0.2, ee_frame));
+      minitao::Vector const point(ee_frame.translation());
+      minitao::Vector force(3), moment(3);
+      force << 3, -2, 5;
+      moment << 0.5, 0.1, -0.3;
+      minitao::Model::external_wrench_list_t wrenches;
+      wrenches.push_back(minitao::Model::ExternalWrench(ee, point, force, moment));
+      ASSERT_TRUE (model->computeInverseDynamics(acceleration, wrenches, tau));
+      minitao::Matrix Jg;
+      ASSERT_TRUE (model->computeJacobian(ee, point, Jg));
+      minitao::Vector wrench(6);
+      wrench << force, moment;
+      {
+	minitao::Vector const tau_wrench_check(tau_check - Jg.transpose() * wrench);
+	std::ostringstream msg;
+	msg << "Checking inverse dynamics with external wrench for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_vector("tau", tau_wrench_check, tau, 1e-6, msg)) << msg.str();
+      }
+      
+      // the KGM tree has to be back at rest afterwards
+      model->computeMassInertia();
+      minitao::Matrix AA_after;
+      model->getMassInertia(AA_after);
+      {
+	std::ostringstream msg;
+	msg << "Checking that mass_inertia is not disturbed for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_matrix("mass_inertia", AA_before, AA_after, 1e-9, msg)) << msg.str();
+      }
+      
+      minitao::Vector const too_short(ndof - 1);
+      EXPECT_FALSE (model->computeInverseDynamics(too_short, tau));
+      wrenches.push_back(minitao::Model::ExternalWrench(ee, point, force, moment.head(2)));
+      EXPECT_FALSE (model->computeInverseDynamics(acceleration, wrenches, tau));
+      wrenches.back() = minitao::Model::ExternalWrench(ee, point.head(2), force, moment);
+      EXPECT_FALSE (model->computeInverseDynamics(acceleration, wrenches, tau));
+      wrenches.back() = minitao::Model::ExternalWrench(ee, point, force.head(2), moment);
+      EXPECT_FALSE (model->computeInverseDynamics(acceleration, wrenches, tau));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+TEST (jspaceModel, forward_dynamics)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    taoDNode * ee(model->findNodeByID(ndof - 1));
+    ASSERT_NE ((void*)0, ee);
+    minitao::State state(ndof, ndof, 0), other(ndof, ndof, 0);
+    minitao::Vector tau(ndof);
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	other.position_[ii] = 0.6 * cos(0.5 * iteration + 1.7 * ii);
+	other.velocity_[ii] = 0.9 * sin(1.4 * iteration + 0.2 * ii);
+	tau[ii] = 10 * cos(0.7 * iteration + 0.3 * ii);
+      }
+      minitao::Vector const acc_other_check(model_forward_dynamics(model, other, tau));
+      minitao::Vector const acc_check(model_forward_dynamics(model, state, tau));
+      minitao::Transform ee_before;
+      model->getGlobalFrame(ee, ee_before);
+      minitao::Matrix Jg_before;
+      model->computeJacobian(ee, Jg_before);
+      minitao::Matrix AA_before;
+      model->getMassInertia(AA_before);
+      
+      minitao::Vector acc;
+      ASSERT_TRUE (model->computeForwardDynamics(state, tau, acc));
+      {
+	std::ostringstream msg;
+	msg << "Checking forward dynamics for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_vector("acceleration", acc_check, acc, 1e-6, msg)) << msg.str();
+      }
+      
+      ASSERT_TRUE (model->computeForwardDynamics(other, tau, acc));
+      {
+	std::ostringstream msg;
+	msg << "Checking forward dynamics at another state q = " << other.position_ << "\n";
+	EXPECT_TRUE (check_vector("acceleration", acc_other_check, acc, 1e-6, msg)) << msg.str();
+      }
+      
+      minitao::Transform ee_after;
+      model->getGlobalFrame(ee, ee_after);
+      minitao::Matrix Jg_after;
+      model->computeJacobian(ee, Jg_after);
+      {
+	std::ostringstream msg;
+	msg << "Checking that kinematics are not disturbed for q = " << state.position_ << "\n";
+	minitao::Matrix const before(ee_before.matrix()), after(ee_after.matrix());
+	EXPECT_TRUE (check_matrix("frame", before, after, 1e-9, msg)) << msg.str();
+	EXPECT_TRUE (check_matrix("Jacobian", Jg_before, Jg_after, 1e-9, msg)) << msg.str();
+      }
+      model->updateDynamics();
+      minitao::Matrix AA_after;
+      model->getMassInertia(AA_after);
+      {
+	std::ostringstream msg;
+	msg << "Checking that dynamics are not disturbed for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_matrix("mass_inertia", AA_before, AA_after, 1e-9, msg)) << msg.str();
+      }
+      
+      minitao::Vector const too_short(ndof - 1);
+      EXPECT_FALSE (model->computeForwardDynamics(state, too_short, acc));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+TEST (jspaceModel, mass_inertia_products)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    minitao::Matrix XX(ndof, 3);
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	for (int jj(0); jj < XX.cols(); ++jj) {
+	  XX.coeffRef(ii, jj) = sin(0.4 * iteration + 1.9 * ii + 2.3 * jj);
+	}
+      }
+      model->update(state);
+      minitao::Matrix AA, Ainv;
+      model->getMassInertia(AA);
+      model->getInverseMassInertia(Ainv);
+      
+      // the products only need a const model
+      minitao::Model const * const_model(model);
+      minitao::Vector const xx(XX.col(0));
+      minitao::Vector result;
+      ASSERT_TRUE (const_model->computeMassInertiaProduct(xx, result));
+      {
+	std::ostringstream msg;
+	msg << "Checking A * x for q = " << state.position_ << "\n";
+	minitao::Vector const check(AA * xx);
+	EXPECT_TRUE (check_vector("A_x", check, result, 1e-6, msg)) << msg.str();
+      }
+      ASSERT_TRUE (const_model->computeInverseMassInertiaProduct(xx, result));
+      {
+	std::ostringstream msg;
+	msg << "Checking Ainv * y for q = " << state.position_ << "\n";
+	minitao::Vector const check(Ainv * xx);
+	EXPECT_TRUE (check_vector("Ainv_y", check, result, 1e-6, msg)) << msg.str();
+      }
+      
+      minitao::Matrix RR;
+      ASSERT_TRUE (model->computeMassInertiaProduct(XX, RR));
+      {
+	std::ostringstream msg;
+	msg << "Checking A * X for q = " << state.position_ << "\n";
+	minitao::Matrix const check(AA * XX);
+	EXPECT_TRUE (check_matrix("A_X", check, RR, 1e-6, msg)) << msg.str();
+      }
+      ASSERT_TRUE (model->computeInverseMassInertiaProduct(XX, RR));
+      {
+	std::ostringstream msg;
+	msg << "Checking Ainv * Y for q = " << state.position_ << "\n";
+	minitao::Matrix const check(Ainv * XX);
+	EXPECT_TRUE (check_matrix("Ainv_Y", check, RR, 1e-6, msg)) << msg.str();
+      }
+      
+      // the KGM tree has to stay at rest
+      model->computeMassInertia();
+      minitao::Matrix AA_after;
+      model->getMassInertia(AA_after);
+      {
+	std::ostringstream msg;
+	EXPECT_TRUE (check_matrix("mass_inertia", AA, AA_after, 1e-9, msg)) << msg.str();
+      }
+      
+      minitao::Matrix const too_short(ndof - 1, 2);
+      EXPECT_FALSE (model->computeInverseMassInertiaProduct(too_short, RR));
+      EXPECT_FALSE (const_model->computeMassInertiaProduct(minitao::Vector::Zero(ndof + 1), result));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, opspace_inertia)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    taoDNode * ee(model->findNodeByID(ndof - 1));
+    ASSERT_NE ((void*) 0, ee) << "no end effector";
+    minitao::State state(ndof, ndof, 0);
+    minitao::Vector qd(ndof);
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	qd[ii] = state.velocity_[ii];
+      }
+      
+      // Time derivative of the Jacobian of a point that is attached
+      // to the end effector, by finite differences along the velocity.
+      double const dt(1e-6);
+      minitao::Vector Jdot_qdot(minitao::Vector::Zero(6));
+      for (int sign(-1); sign <= 1; sign += 2) {
+	minitao::State moved(state);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  moved.position_[ii] += sign * dt * state.velocity_[ii];
+	}
+	model->update(moved);
+	minitao::Transform point;
+	ASSERT_TRUE (model->computeGlobalFrame(ee, 0.1, -0.05, 0.2, point));
+	minitao::Matrix JJ;
+	ASSERT_TRUE (model->computeJacobian(ee, point.translation(), JJ));
+	Jdot_qdot += sign * JJ * qd / (2 * dt);
+      }
+      
+      model->update(state);
+      minitao::Transform point_frame;
+      ASSERT_TRUE (model->computeGlobalFrame(ee, 0.1, -0.05, 0.2, point_frame));
+      minitao::Vector const point(point_frame.translation());
+      minitao::Matrix JJ, Ainv;
+      ASSERT_TRUE (model->computeJacobian(ee, point, JJ));
+      model->getInverseMassInertia(Ainv);
+      minitao::Vector gg, bb;
+      ASSERT_TRUE (model->getGravity(gg));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(bb));
+      minitao::Matrix const lambda_check((JJ * Ainv * JJ.transpose()).inverse());
+      
+      minitao::Matrix lambda;
+      ASSERT_TRUE (model->computeOpSpaceInertia(ee, point, lambda));
+      {
+	std::ostringstream msg;
+	msg << "Checking Lambda for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_matrix("lambda", lambda_check, lambda, 1e-6, msg)) << msg.str();
+      }
+      
+      // second point on the same node goes through the cached factor
+      minitao::Vector origin(3);
+      origin << point_frame.translation() - point_frame.linear() * Eigen::Vector3d(0.1, -0.05, 0.2);
+      ASSERT_TRUE (model->computeJacobian(ee, origin, JJ));
+      ASSERT_TRUE (model->computeOpSpaceInertia(ee, origin, lambda));
+      {
+	std::ostringstream msg;
+	msg << "Checking Lambda at node origin for q = " << state.position_ << "\n";
+	minitao::Matrix const check((JJ * Ainv * JJ.transpose()).inverse());
+	EXPECT_TRUE (check_matrix("lambda_origin", check, lambda, 1e-6, msg)) << msg.str();
+      }
+      
+      ASSERT_TRUE (model->computeJacobian(ee, point, JJ));
+      minitao::Vector mu, pp;
+      ASSERT_TRUE (model->computeOpSpaceBias(ee, point, mu, pp));
+      {
+	std::ostringstream msg;
+	msg << "Checking op-space Coriolis-centrifugal for q = " << state.position_
+	    << "  dq = " << state.velocity_ << "\n";
+	minitao::Vector const check(lambda_check * (JJ * Ainv * bb - Jdot_qdot));
+	EXPECT_TRUE (check_vector("mu", check, mu, 1e-3, msg)) << msg.str();
+      }
+      {
+	std::ostringstream msg;
+	msg << "Checking op-space gravity for q = " << state.position_ << "\n";
+	minitao::Vector const check(lambda_check * JJ * Ainv * gg);
+	EXPECT_TRUE (check_vector("p", check, pp, 1e-6, msg)) << msg.str();
+      }
+    }
+    
+    minitao::Matrix lambda;
+    minitao::Vector const point(minitao::Vector::Zero(3));
+    EXPECT_FALSE (model->computeOpSpaceInertia(0, point, lambda));
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+// Model::computeJacobian() fills in all columns, which is only
+// correct for unbranched robots. Knock out the columns of joints that
+// are not ancestors of the node (assumes that node IDs are DOF
+// indices).
+static void zero_non_ancestor_columns(minitao::Model * model, taoDNode * node, minitao::Matrix & jacobian)
+{
+  for (int icol(0); icol < jacobian.cols(); ++icol) {
+    taoDNode * const joint_node(model->findNodeByID(icol));
+    taoDNode * ancestor(node);
+    while (ancestor && (ancestor != joint_node)) {
+      ancestor = ancestor->getDParent();
+    }
+    if ( ! ancestor) {
+      jacobian.col(icol).setZero();
+    }
+  }
+}
+
+
+TEST (jspaceModel, delassus)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_branching_model();
+    size_t const ndof(model->getNDOF());
+    ASSERT_EQ (6, ndof) << "unexpected NDOF of branching model";
+    minitao::State state(ndof, ndof, 0);
+    
+    // two contacts on the same node, plus one on the other arm and
+    // one on the trunk
+    int const contact_id[] = { 5, 3, 3, 0 };
+    double const local_point[][3] = { { 0.8, 0, 0 }, { 0.1, 0, 0.2 }, { -0.1, 0.05, 0.2 }, { 0, 0.1, 0.5 } };
+    size_t const ncontacts(sizeof(contact_id) / sizeof(*contact_id));
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      model->update(state);
+      minitao::Matrix Ainv;
+      model->getInverseMassInertia(Ainv);
+      
+      minitao::Model::contact_list_t contacts;
+      minitao::Matrix JJ(3 * ncontacts, ndof);
+      for (size_t ic(0); ic < ncontacts; ++ic) {
+	taoDNode * node(model->findNodeByID(contact_id[ic]));
+	ASSERT_NE ((void*) 0, node) << "no node with ID " << contact_id[ic];
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, local_point[ic][0], local_point[ic][1],
+					       local_point[ic][2], frame));
+	minitao::Vector const point(frame.translation());
+	contacts.push_back(minitao::Model::Contact(node, point));
+	minitao::Matrix Jc;
+	ASSERT_TRUE (model->computeJacobian(node, point, Jc));
+	zero_non_ancestor_columns(model, node, Jc);
+	JJ.block(3 * ic, 0, 3, ndof) = Jc.topRows(3);
+      }
+      
+      minitao::Matrix delassus;
+      ASSERT_TRUE (model->computeDelassusMatrix(contacts, delassus));
+      std::ostringstream msg;
+      msg << "Checking Delassus matrix for q = " << state.position_ << "\n";
+      minitao::Matrix const check(JJ * Ainv * JJ.transpose());
+      EXPECT_TRUE (check_matrix("delassus", check, delassus, 1e-6, msg)) << msg.str();
+    }
+    
+    minitao::Matrix delassus;
+    minitao::Model::contact_list_t contacts;
+    contacts.push_back(minitao::Model::Contact(0, minitao::Vector::Zero(3)));
+    EXPECT_FALSE (model->computeDelassusMatrix(contacts, delassus));
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+// Acceleration of a point attached to a node, computed with the
+// Jacobian and the joint acceleration. The velocity term Jdot * qdot
+// is obtained from finite differences along the velocity. Leaves the
+// model updated to the given state.
+static minitao::Vector point_acceleration(minitao::Model * model,
+					  minitao::State const & state,
+					  minitao::Vector const & acceleration,
+					  taoDNode * node,
+					  double local_x, double local_y, double local_z)
+{
+  size_t const ndof(model->getNDOF());
+  minitao::Vector qd(ndof);
+  for (size_t ii(0); ii < ndof; ++ii) {
+    qd[ii] = state.velocity_[ii];
+  }
+  double const dt(1e-6);
+  minitao::Vector result(minitao::Vector::Zero(6));
+  for (int sign(-1); sign <= 1; sign += 2) {
+    minitao::State moved(state);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      moved.position_[ii] += sign * dt * state.velocity_[ii];
+    }
+    model->update(moved);
+    minitao::Transform point;
+    model->computeGlobalFrame(node, local_x, local_y, local_z, point);
+    minitao::Matrix JJ;
+    model->computeJacobian(node, point.translation(), JJ);
+    zero_non_ancestor_columns(model, node, JJ);
+    result += sign * JJ * qd / (2 * dt);
+  }
+  model->update(state);
+  minitao::Transform point;
+  model->computeGlobalFrame(node, local_x, local_y, local_z, point);
+  minitao::Matrix JJ;
+  model->computeJacobian(node, point.translation(), JJ);
+  zero_non_ancestor_columns(model, node, JJ);
+  result += JJ * acceleration;
+  return result;
+}
+
+
+TEST (jspaceModel, opspace_inverse_dynamics)
+{
+  minitao::Model * model(0);
+  try {
+    // Two position tasks on different arms of the branching robot,
+    // which are coupled through the trunk, and a full six-DOF task
+    // on the end effector of the puma.
+    for (int robot(0); robot < 2; ++robot) {
+      delete model;
+      model = 0;
+      model = (0 == robot) ? create_branching_model() : create_puma_model();
+      size_t const ndof(model->getNDOF());
+      int const ee_id[] = { 5, 3 };
+      double const local_point[][3] = { { 0.3, 0.4, 0.1 }, { 0.1, 0, 0.2 } };
+      size_t const nee((0 == robot) ? 2 : 1);
+      int const ee_size((0 == robot) ? 3 : 6);
+      minitao::State state(ndof, ndof, 0);
+      
+      for (size_t iteration(0); iteration < 3; ++iteration) {
+	minitao::Vector tau_null(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	  state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	  tau_null[ii] = 2.0 * sin(0.6 * iteration + 1.7 * ii);
+	}
+	model->update(state);
+	
+	minitao::Model::end_effector_list_t end_effectors;
+	for (size_t ie(0); ie < nee; ++ie) {
+	  taoDNode * node(model->findNodeByID((0 == robot) ? ee_id[ie] : ndof - 1));
+	  ASSERT_NE ((void*) 0, node) << "no end effector " << ie;
+	  minitao::Transform frame;
+	  ASSERT_TRUE (model->computeGlobalFrame(node, local_point[ie][0], local_point[ie][1],
+						 local_point[ie][2], frame));
+	  minitao::Vector desired(ee_size);
+	  for (int jj(0); jj < ee_size; ++jj) {
+	    desired[jj] = 3.0 * cos(0.8 * iteration + 1.3 * jj + 2.1 * ie);
+	  }
+	  minitao::Vector const point(frame.translation());
+	  end_effectors.push_back(minitao::Model::EndEffector(node, point, desired));
+	}
+	
+	minitao::Vector tau;
+	ASSERT_TRUE (model->computeOpSpaceInverseDynamics(end_effectors, tau_null, tau));
+	minitao::Vector const acceleration(model_forward_dynamics(model, state, tau));
+	for (size_t ie(0); ie < nee; ++ie) {
+	  std::ostringstream msg;
+	  msg << "Checking acceleration of end effector " << ie << " of robot " << robot
+	      << " for q = " << state.position_ << "  dq = " << state.velocity_ << "\n";
+	  minitao::Vector const check(point_acceleration(model, state, acceleration,
+							 const_cast<taoDNode*>(end_effectors[ie].node),
+							 local_point[ie][0], local_point[ie][1], local_point[ie][2]));
+	  EXPECT_TRUE (check_vector("xdd", end_effectors[ie].acceleration, minitao::Vector(check.head(ee_size)), 1e-3, msg))
+	    << msg.str();
+	}
+      }
+      
+      minitao::Vector tau;
+      minitao::Model::end_effector_list_t end_effectors;
+      end_effectors.push_back(minitao::Model::EndEffector(model->findNodeByID(0),
+							  minitao::Vector::Zero(3),
+							  minitao::Vector::Zero(4)));
+      EXPECT_FALSE (model->computeOpSpaceInverseDynamics(end_effectors, minitao::Vector::Zero(ndof), tau));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, jacobian_products)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_branching_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    int const node_id[] = { 5, 3, 2, 0 };
+    size_t const nnodes(sizeof(node_id) / sizeof(*node_id));
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      minitao::Vector velocity(ndof);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	velocity[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+      }
+      model->update(state);
+      
+      minitao::Model::external_wrench_list_t wrenches;
+      minitao::Vector tau_sum(ndof);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	tau_sum[ii] = 0.1 * ii;
+      }
+      minitao::Vector tau_all(tau_sum);
+      
+      for (size_t in(0); in < nnodes; ++in) {
+	taoDNode * node(model->findNodeByID(node_id[in]));
+	ASSERT_NE ((void*) 0, node) << "no node with ID " << node_id[in];
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, 0.2, -0.1, 0.3 * in, frame));
+	minitao::Vector const point(frame.translation());
+	minitao::Matrix JJ;
+	ASSERT_TRUE (model->computeJacobian(node, point, JJ));
+	zero_non_ancestor_columns(model, node, JJ);
+	
+	minitao::Vector twist;
+	ASSERT_TRUE (model->computeJacobianProduct(node, point, velocity, twist));
+	{
+	  std::ostringstream msg;
+	  msg << "Checking J * v for node " << node_id[in] << " and q = " << state.position_ << "\n";
+	  minitao::Vector const check(JJ * velocity);
+	  EXPECT_TRUE (check_vector("twist", check, twist, 1e-6, msg)) << msg.str();
+	}
+	
+	minitao::Vector wrench(6);
+	for (size_t jj(0); jj < 6; ++jj) {
+	  wrench[jj] = 2.0 * sin(0.5 * iteration + 1.9 * jj + 0.7 * in);
+	}
+	minitao::Vector tau;
+	ASSERT_TRUE (model->computeJacobianTransposeProduct(node, point, wrench, tau));
+	{
+	  std::ostringstream msg;
+	  msg << "Checking J^T * f for node " << node_id[in] << " and q = " << state.position_ << "\n";
+	  minitao::Vector const check(JJ.transpose() * wrench);
+	  EXPECT_TRUE (check_vector("tau", check, tau, 1e-6, msg)) << msg.str();
+	}
+	tau_sum += tau;
+	wrenches.push_back(minitao::Model::ExternalWrench(node, point, wrench.head(3), wrench.tail(3)));
+      }
+      
+      ASSERT_TRUE (model->addJacobianTransposeProduct(wrenches, tau_all));
+      std::ostringstream msg;
+      msg << "Checking accumulated J^T * f for q = " << state.position_ << "\n";
+      EXPECT_TRUE (check_vector("tau_all", tau_sum, tau_all, 1e-6, msg)) << msg.str();
+      
+      wrenches.back().moment.resize(2);
+      minitao::Vector const tau_before(tau_all);
+      EXPECT_FALSE (model->addJacobianTransposeProduct(wrenches, tau_all));
+      EXPECT_TRUE (tau_before == tau_all);
+    }
+    
+    minitao::Vector tau(ndof - 1);
+    EXPECT_FALSE (model->addJacobianTransposeProduct(minitao::Model::external_wrench_list_t(), tau));
+    minitao::Vector twist;
+    EXPECT_FALSE (model->computeJacobianProduct(0, minitao::Vector::Zero(3), minitao::Vector::Zero(ndof), twist));
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, sparse_jacobian)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_branching_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    // number of ancestors (including the node itself) for each ID
+    size_t const nancestors[] = { 1, 2, 3, 4, 2, 3 };
+    minitao::SparseJacobian::part_t const part[] = {
+      minitao::SparseJacobian::FULL,
+      minitao::SparseJacobian::POSITION,
+      minitao::SparseJacobian::ORIENTATION
+    };
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      minitao::Vector velocity(ndof);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	velocity[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+      }
+      model->update(state);
+      
+      for (size_t id(0); id < ndof; ++id) {
+	taoDNode * node(model->findNodeByID(id));
+	ASSERT_NE ((void*) 0, node) << "no node with ID " << id;
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, 0.2, -0.1, 0.3, frame));
+	minitao::Vector const point(frame.translation());
+	minitao::Matrix JJ;
+	ASSERT_TRUE (model->computeJacobian(node, point, JJ));
+	zero_non_ancestor_columns(model, node, JJ);
+	
+	for (size_t ip(0); ip < 3; ++ip) {
+	  minitao::SparseJacobian sparse;
+	  ASSERT_TRUE (model->computeSparseJacobian(node, point, part[ip], sparse));
+	  EXPECT_EQ (nancestors[id], sparse.dof_.size()) << "wrong number of columns for node " << id;
+	  minitao::Matrix const check((minitao::SparseJacobian::FULL == part[ip]) ? JJ
+				      : (minitao::SparseJacobian::POSITION == part[ip]) ? JJ.topRows(3)
+				      : JJ.bottomRows(3));
+	  std::ostringstream msg;
+	  msg << "Checking sparse Jacobian part " << ip << " of node " << id
+	      << " for q = " << state.position_ << "\n";
+	  minitao::Matrix full;
+	  sparse.scatter(ndof, full);
+	  EXPECT_TRUE (check_matrix("scatter", check, full, 1e-9, msg)) << msg.str();
+	  
+	  minitao::Vector product;
+	  sparse.multiply(velocity, product);
+	  EXPECT_TRUE (check_vector("multiply", minitao::Vector(check * velocity), product, 1e-9, msg))
+	    << msg.str();
+	  
+	  minitao::Vector const ff(minitao::Vector::Ones(check.rows()));
+	  minitao::Vector tau(velocity);
+	  sparse.addTransposeProduct(ff, tau);
+	  EXPECT_TRUE (check_vector("transpose", minitao::Vector(velocity + check.transpose() * ff), tau, 1e-9, msg))
+	    << msg.str();
+	}
+      }
+    }
+    
+    minitao::SparseJacobian sparse;
+    EXPECT_FALSE (model->computeSparseJacobian(0, minitao::Vector::Zero(3), minitao::SparseJacobian::FULL, sparse));
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, stacked_jacobian)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_branching_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    int const node_id[] = { 5, 3, 3, 0, 2, 5 };
+    size_t const nancestors[] = { 3, 4, 4, 1, 3, 3 };
+    size_t const npoints(sizeof(node_id) / sizeof(*node_id));
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      model->update(state);
+      
+      minitao::Model::node_point_list_t points;
+      minitao::Matrix check(6 * npoints, ndof);
+      size_t nnz(0);
+      for (size_t ip(0); ip < npoints; ++ip) {
+	taoDNode * node(model->findNodeByID(node_id[ip]));
+	ASSERT_NE ((void*) 0, node) << "no node with ID " << node_id[ip];
+	minitao::Vector local_point(3);
+	local_point << 0.1 * ip, -0.2, 0.3;
+	points.push_back(minitao::Model::NodePoint(node, local_point));
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, local_point, frame));
+	minitao::Matrix JJ;
+	ASSERT_TRUE (model->computeJacobian(node, frame.translation(), JJ));
+	zero_non_ancestor_columns(model, node, JJ);
+	check.block(6 * ip, 0, 6, ndof) = JJ;
+	nnz += 3 * nancestors[ip];
+      }
+      
+      std::ostringstream msg;
+      msg << "Checking stacked Jacobians for q = " << state.position_ << "\n";
+      minitao::Matrix dense;
+      ASSERT_TRUE (model->computeStackedJacobian(points, minitao::SparseJacobian::FULL, dense));
+      EXPECT_TRUE (check_matrix("dense", check, dense, 1e-9, msg)) << msg.str();
+      
+      minitao::Matrix position_check(3 * npoints, ndof);
+      for (size_t ip(0); ip < npoints; ++ip) {
+	position_check.block(3 * ip, 0, 3, ndof) = check.block(6 * ip, 0, 3, ndof);
+      }
+      minitao::SparseMatrix csc;
+      ASSERT_TRUE (model->computeStackedJacobian(points, minitao::SparseJacobian::POSITION, csc));
+      EXPECT_EQ (nnz, static_cast<size_t>(csc.nonZeros()));
+      EXPECT_TRUE (check_matrix("csc", position_check, minitao::Matrix(csc), 1e-9, msg)) << msg.str();
+      
+      minitao::SparseRowMatrix csr;
+      ASSERT_TRUE (model->computeStackedJacobian(points, minitao::SparseJacobian::POSITION, csr));
+      EXPECT_EQ (nnz, static_cast<size_t>(csr.nonZeros()));
+      EXPECT_TRUE (check_matrix("csr", position_check, minitao::Matrix(csr), 1e-9, msg)) << msg.str();
+    }
+    
+    minitao::Model::node_point_list_t points;
+    points.push_back(minitao::Model::NodePoint(0, minitao::Vector::Zero(3)));
+    minitao::Matrix dense;
+    EXPECT_FALSE (model->computeStackedJacobian(points, minitao::SparseJacobian::FULL, dense));
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, jdot_qdot)
+{
+  minitao::Model * model(0);
+  try {
+    for (size_t imodel(0); imodel < 2; ++imodel) {
+      delete model;
+      model = 0;
+      if (0 == imodel) {
+	model = create_branching_model();
+      }
+      else {
+	model = create_puma_model();
+      }
+      size_t const ndof(model->getNDOF());
+      minitao::State state(ndof, ndof, 0);
+      minitao::Vector const zero_acc(minitao::Vector::Zero(ndof));
+      
+      for (size_t iteration(0); iteration < 3; ++iteration) {
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	  state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	}
+	model->update(state);
+	
+	minitao::Model::node_point_list_t points;
+	minitao::Vector check(3 * ndof);
+	for (size_t inode(0); inode < ndof; ++inode) {
+	  taoDNode * node(model->findNodeByID(inode));
+	  ASSERT_NE ((void*) 0, node) << "no node with ID " << inode;
+	  minitao::Vector local_point(3);
+	  local_point << 0.1, -0.2 * inode, 0.3;
+	  points.push_back(minitao::Model::NodePoint(node, local_point));
+	  
+	  minitao::Vector const want(point_acceleration(model, state, zero_acc, node,
+							local_point[0], local_point[1], local_point[2]));
+	  check.segment(3 * inode, 3) = want.tail(3);
+	  minitao::Transform frame;
+	  ASSERT_TRUE (model->computeGlobalFrame(node, local_point, frame));
+	  minitao::Vector have;
+	  ASSERT_TRUE (model->computeJdotQdot(node, frame.translation(), have));
+	  std::ostringstream msg;
+	  msg << "Checking Jdot * qdot of node " << inode << " for\n"
+	      << "  q  = " << state.position_ << "\n"
+	      << "  qd = " << state.velocity_ << "\n";
+	  EXPECT_TRUE (check_vector("jdot_qdot", want, have, 1e-5, msg)) << msg.str();
+	}
+	
+	std::ostringstream msg;
+	msg << "Checking bulk Jdot * qdot for q = " << state.position_ << "\n";
+	minitao::Vector stacked;
+	ASSERT_TRUE (model->computeJdotQdot(points, minitao::SparseJacobian::ORIENTATION, stacked));
+	EXPECT_TRUE (check_vector("stacked", check, stacked, 1e-5, msg)) << msg.str();
+      }
+      
+      minitao::Vector jdot_qdot;
+      EXPECT_FALSE (model->computeJdotQdot(0, minitao::Vector::Zero(3), jdot_qdot));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, coriolis_matrix)
+{
+  minitao::Model * model(0);
+  try {
+    for (size_t imodel(0); imodel < 2; ++imodel) {
+      delete model;
+      model = 0;
+      if (0 == imodel) {
+	model = create_branching_model();
+      }
+      else {
+	model = create_puma_model();
+      }
+      size_t const ndof(model->getNDOF());
+      minitao::State state(ndof, ndof, 0);
+      minitao::Matrix CC;
+      EXPECT_FALSE (model->getCoriolisMatrix(CC));
+      
+      for (size_t iteration(0); iteration < 3; ++iteration) {
+	minitao::Vector qd(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	  state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	  qd[ii] = state.velocity_[ii];
+	}
+	
+	// time derivative of the mass-inertia matrix along the velocity
+	double const dt(1e-6);
+	minitao::Matrix AAdot(minitao::Matrix::Zero(ndof, ndof));
+	for (int sign(-1); sign <= 1; sign += 2) {
+	  minitao::State moved(state);
+	  for (size_t ii(0); ii < ndof; ++ii) {
+	    moved.position_[ii] += sign * dt * state.velocity_[ii];
+	  }
+	  model->update(moved);
+	  minitao::Matrix AA;
+	  ASSERT_TRUE (model->getMassInertia(AA));
+	  AAdot += sign * AA / (2 * dt);
+	}
+	
+	model->update(state);
+	model->computeCoriolisMatrix();
+	ASSERT_TRUE (model->getCoriolisMatrix(CC));
+	minitao::Vector cc;
+	ASSERT_TRUE (model->getCoriolisCentrifugal(cc));
+	
+	std::ostringstream msg;
+	msg << "Checking Coriolis matrix for\n"
+	    << "  q  = " << state.position_ << "\n"
+	    << "  qd = " << state.velocity_ << "\n";
+	EXPECT_TRUE (check_vector("C * qd", cc, minitao::Vector(CC * qd), 1e-6, msg)) << msg.str();
+	minitao::Matrix const NN(AAdot - 2 * CC);
+	EXPECT_TRUE (check_matrix("skew", minitao::Matrix(- NN.transpose()), NN, 1e-5, msg)) << msg.str();
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, centroidal)
+{
+  minitao::Model * model(0);
+  try {
+    for (size_t imodel(0); imodel < 2; ++imodel) {
+      delete model;
+      model = 0;
+      if (0 == imodel) {
+	model = create_branching_model();
+      }
+      else {
+	model = create_puma_model();
+      }
+      size_t const ndof(model->getNDOF());
+      double const total_mass(minitao::computeTotalMass(model->_getKGMRoot()));
+      minitao::State state(ndof, ndof, 0);
+      
+      for (size_t iteration(0); iteration < 3; ++iteration) {
+	minitao::Vector qd(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	  state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	  qd[ii] = state.velocity_[ii];
+	}
+	
+	// time derivatives by finite differences along the velocity
+	double const dt(1e-6);
+	minitao::Vector com_dot(minitao::Vector::Zero(3));
+	minitao::Vector momentum_dot(minitao::Vector::Zero(6));
+	for (int sign(-1); sign <= 1; sign += 2) {
+	  minitao::State moved(state);
+	  for (size_t ii(0); ii < ndof; ++ii) {
+	    moved.position_[ii] += sign * dt * state.velocity_[ii];
+	  }
+	  model->update(moved);
+	  minitao::Vector com;
+	  ASSERT_TRUE (model->computeCenterOfMass(com));
+	  com_dot += sign * com / (2 * dt);
+	  minitao::Matrix AG;
+	  minitao::Vector bias;
+	  ASSERT_TRUE (model->computeCentroidalMomentum(AG, bias));
+	  momentum_dot += sign * AG * qd / (2 * dt);
+	}
+	model->update(state);
+	
+	// linear and angular (about the CoM) momentum summed over links
+	minitao::Vector com, com_check(minitao::Vector::Zero(3));
+	ASSERT_TRUE (model->computeCenterOfMass(com));
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  taoDNode * node(model->findNodeByID(ii));
+	  deVector3 const & lcom(*node->center());
+	  minitao::Transform frame;
+	  ASSERT_TRUE (model->computeGlobalFrame(node, lcom[0], lcom[1], lcom[2], frame));
+	  com_check += *node->mass() * frame.translation() / total_mass;
+	}
+	minitao::Vector momentum_check(minitao::Vector::Zero(6));
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  taoDNode * node(model->findNodeByID(ii));
+	  double const mass(*node->mass());
+	  deVector3 const & lcom(*node->center());
+	  deMatrix3 const & lin(*node->inertia());
+	  Eigen::Vector3d const local_com(lcom[0], lcom[1], lcom[2]);
+	  Eigen::Matrix3d local_inertia;
+	  for (int jj(0); jj < 3; ++jj) {
+	    for (int kk(0); kk < 3; ++kk) {
+	      local_inertia.coeffRef(jj, kk) = lin[jj][kk];
+	    }
+	  }
+	  Eigen::Matrix3d lcx;
+	  lcx <<            0, -local_com.z(),  local_com.y(),
+	     local_com.z(),             0, -local_com.x(),
+	    -local_com.y(),  local_com.x(),             0;
+	  minitao::Transform frame;
+	  ASSERT_TRUE (model->computeGlobalFrame(node, lcom[0], lcom[1], lcom[2], frame));
+	  Eigen::Matrix3d const rot(frame.rotation());
+	  minitao::Matrix JJ;
+	  ASSERT_TRUE (model->computeJacobian(node, frame.translation(), JJ));
+	  zero_non_ancestor_columns(model, node, JJ);
+	  minitao::Vector const twist(JJ * qd);
+	  Eigen::Vector3d const linear(mass * twist.head(3));
+	  Eigen::Vector3d const rr(frame.translation() - Eigen::Vector3d(com));
+	  momentum_check.head(3) += linear;
+	  momentum_check.tail(3) += rr.cross(linear)
+	    + rot * (local_inertia + mass * lcx * lcx) * rot.transpose() * twist.tail(3);
+	}
+	
+	std::ostringstream msg;
+	msg << "Checking centroidal quantities for\n"
+	    << "  q  = " << state.position_ << "\n"
+	    << "  qd = " << state.velocity_ << "\n";
+	EXPECT_TRUE (check_vector("com", com_check, com, 1e-9, msg)) << msg.str();
+	minitao::Vector com2;
+	minitao::Matrix Jcom;
+	ASSERT_TRUE (model->computeCenterOfMass(com2, Jcom));
+	EXPECT_TRUE (check_vector("com2", com, com2, 1e-9, msg)) << msg.str();
+	EXPECT_TRUE (check_vector("Jcom * qd", com_dot, minitao::Vector(Jcom * qd), 1e-6, msg)) << msg.str();
+	
+	minitao::Matrix AG;
+	minitao::Vector bias;
+	ASSERT_TRUE (model->computeCentroidalMomentum(AG, bias));
+	EXPECT_TRUE (check_vector("momentum", momentum_check, minitao::Vector(AG * qd), 1e-9, msg)) << msg.str();
+	EXPECT_TRUE (check_vector("bias", momentum_dot, bias, 1e-5, msg)) << msg.str();
+	
+	minitao::Matrix AA;
+	ASSERT_TRUE (model->getMassInertia(AA));
+	double kinetic;
+	ASSERT_TRUE (model->computeKineticEnergy(kinetic));
+	EXPECT_NEAR (0.5 * qd.dot(AA * qd), kinetic, 1e-9);
+	EXPECT_NEAR (9.81 * total_mass * com[2], model->computePotentialEnergy(), 1e-9);
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, gravity_kernel)
+{
+  minitao::Model * model(0);
+  try {
+    for (size_t imodel(0); imodel < 2; ++imodel) {
+      delete model;
+      model = 0;
+      if (0 == imodel) {
+	model = create_branching_model();
+      }
+      else {
+	model = create_puma_model();
+      }
+      size_t const ndof(model->getNDOF());
+      minitao::State state(ndof, ndof, 0);
+      minitao::jointVector_t joints;
+      minitao::enumerateJoints(joints, model->_getKGMRoot());
+      
+      for (size_t iteration(0); iteration < 5; ++iteration) {
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 1.5 * sin(1.3 * iteration + 0.7 * ii);
+	}
+	model->update(state);
+	minitao::Vector gravity;
+	ASSERT_TRUE (model->getGravity(gravity));
+	
+	static deVector3 const earth_gravity(0, 0, -9.81);
+	taoDynamics::invDynamics(model->_getKGMRoot(), &earth_gravity);
+	minitao::Vector check(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  joints[ii]->getTau(&check[ii]);
+	  joints[ii]->zeroTau();
+	}
+	
+	std::ostringstream msg;
+	msg << "Checking gravity kernel for q = " << state.position_ << "\n";
+	EXPECT_TRUE (check_vector("gravity", check, gravity, 1e-9, msg)) << msg.str();
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, gravity_basis)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    minitao::jointVector_t joints;
+    minitao::enumerateJoints(joints, model->_getKGMRoot());
+    minitao::Matrix basis;
+    minitao::Vector gravity;
+    EXPECT_FALSE (model->getGravityBasis(basis));
+    EXPECT_FALSE (model->getGravity(minitao::Vector::Zero(3), gravity));
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 1.5 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      model->update(state);
+      ASSERT_TRUE (model->getGravityBasis(basis));
+      EXPECT_EQ (ndof, static_cast<size_t>(basis.rows()));
+      EXPECT_EQ (3, basis.cols());
+      
+      for (size_t ig(0); ig < 3; ++ig) {
+	// e.g. tilted gravity on a ship, or gravity minus a base acceleration
+	deVector3 const tao_gravity(2.0 * cos(1.1 * ig + iteration), 1.5 * sin(0.7 * ig), -9.81 + ig);
+	minitao::Vector g_vector(3);
+	g_vector << tao_gravity[0], tao_gravity[1], tao_gravity[2];
+	taoDynamics::invDynamics(model->_getKGMRoot(), &tao_gravity);
+	minitao::Vector check(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  joints[ii]->getTau(&check[ii]);
+	  joints[ii]->zeroTau();
+	}
+	
+	std::ostringstream msg;
+	msg << "Checking gravity basis for q = " << state.position_ << "  g = " << g_vector << "\n";
+	ASSERT_TRUE (model->getGravity(g_vector, gravity));
+	EXPECT_TRUE (check_vector("gravity", check, gravity, 1e-9, msg)) << msg.str();
+	
+	model->disableGravityCompensation(1, true);
+	ASSERT_TRUE (model->getGravity(g_vector, gravity));
+	check[1] = 0;
+	EXPECT_TRUE (check_vector("disabled", check, gravity, 1e-9, msg)) << msg.str();
+	model->disableGravityCompensation(1, false);
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, hybrid_dynamics)
+{
+  minitao::Model * model(0);
+  try {
+    for (size_t imodel(0); imodel < 2; ++imodel) {
+      delete model;
+      model = 0;
+      if (0 == imodel) {
+	model = create_branching_model();
+      }
+      else {
+	model = create_puma_model();
+      }
+      size_t const ndof(model->getNDOF());
+      minitao::State state(ndof, ndof, 0);
+      
+      for (size_t iteration(0); iteration < 4; ++iteration) {
+	minitao::Vector full_acc(ndof);
+	std::vector<bool> acceleration_given(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	  state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	  full_acc[ii] = 2.0 * sin(0.3 * iteration - 1.1 * ii);
+	  // all torques, all accelerations, and two mixed patterns
+	  acceleration_given[ii] = (1 == iteration) || ((2 == iteration) && (ii % 2)) || ((3 == iteration) && (ii > 2));
+	}
+	minitao::Vector const full_tau(model_inverse_dynamics(model, state, full_acc));
+	
+	minitao::Vector acceleration(ndof), tau(ndof);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  if (acceleration_given[ii]) {
+	    acceleration[ii] = full_acc[ii];
+	    tau[ii] = 0;
+	  }
+	  else {
+	    acceleration[ii] = 0;
+	    tau[ii] = full_tau[ii];
+	  }
+	}
+	
+	std::ostringstream msg;
+	msg << "Checking hybrid dynamics for iteration " << iteration << "\n"
+	    << "  q  = " << state.position_ << "\n"
+	    << "  qd = " << state.velocity_ << "\n";
+	ASSERT_TRUE (model->computeHybridDynamics(acceleration_given, acceleration, tau));
+	EXPECT_TRUE (check_vector("acceleration", full_acc, acceleration, 1e-6, msg)) << msg.str();
+	EXPECT_TRUE (check_vector("tau", full_tau, tau, 1e-6, msg)) << msg.str();
+      }
+      
+      minitao::Vector acceleration(ndof), tau(ndof - 1);
+      EXPECT_FALSE (model->computeHybridDynamics(std::vector<bool>(ndof, false), acceleration, tau));
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+static void body_frame_move(char const * joint_types, minitao::State const & state, double dt,
+			    minitao::State & moved)
+{
+  // Free ('F') and spherical ('S') joints have their velocity
+  // expressed in the node frame, so the translation moves along the
+  // rotated linear velocity and the orientation gets the body-frame
+  // rotation appended. All other joints just add up.
+  moved = state;
+  for (size_t ij(0), ipos(0), idof(0); 0 != joint_types[ij]; ++ij) {
+    if (('F' != joint_types[ij]) && ('S' != joint_types[ij])) {
+      moved.position_[ipos++] += dt * state.velocity_[idof++];
+      continue;
+    }
+    size_t const iquat(('F' == joint_types[ij]) ? ipos + 3 : ipos);
+    Eigen::Quaterniond const qq(state.position_[iquat + 3], state.position_[iquat],
+				state.position_[iquat + 1], state.position_[iquat + 2]);
+    if ('F' == joint_types[ij]) {
+      Eigen::Vector3d const linear(qq * Eigen::Vector3d(state.velocity_[idof], state.velocity_[idof + 1],
+							 state.velocity_[idof + 2]));
+      for (size_t ii(0); ii < 3; ++ii) {
+	moved.position_[ipos + ii] += dt * linear[ii];
+      }
+      idof += 3;
+    }
+    Eigen::Vector3d const angular(state.velocity_[idof], state.velocity_[idof + 1], state.velocity_[idof + 2]);
+    Eigen::Quaterniond moved_qq(qq);
+    if (angular.norm() > 0) {
+      moved_qq = qq * Eigen::Quaterniond(Eigen::AngleAxisd(angular.norm() * dt, angular.normalized()));
+    }
+    moved.position_[iquat] = moved_qq.x();
+    moved.position_[iquat + 1] = moved_qq.y();
+    moved.position_[iquat + 2] = moved_qq.z();
+    moved.position_[iquat + 3] = moved_qq.w();
+    ipos = iquat + 4;
+    idof += 3;
+  }
+}
+
+
+TEST (jspaceModel, free_flyer)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_free_flyer_model();
+    ASSERT_EQ (4, model->getNNodes());
+    ASSERT_EQ (4, model->getNJoints());
+    ASSERT_EQ (9, model->getNDOF());
+    ASSERT_EQ (10, model->getNPositions());
+    size_t const ndof(model->getNDOF());
+    size_t const npos(model->getNPositions());
+    minitao::State state(npos, ndof, 0);
+    
+    minitao::Model::node_point_list_t points;
+    double mass[4];
+    Eigen::Matrix3d com_inertia[4];
+    for (int id(0); id < 4; ++id) {
+      taoDNode * node(model->findNodeByID(id));
+      ASSERT_NE ((void*) 0, node);
+      deVector3 const & lcom(*node->center());
+      points.push_back(minitao::Model::NodePoint(node, minitao::Vector(Eigen::Vector3d(lcom[0], lcom[1], lcom[2]))));
+      mass[id] = *node->mass();
+      deMatrix3 const & lin(*node->inertia());
+      Eigen::Vector3d const local_com(lcom[0], lcom[1], lcom[2]);
+      Eigen::Matrix3d lcx;
+      lcx <<            0, -local_com.z(),  local_com.y(),
+	 local_com.z(),             0, -local_com.x(),
+	-local_com.y(),  local_com.x(),             0;
+      for (int jj(0); jj < 3; ++jj) {
+	for (int kk(0); kk < 3; ++kk) {
+	  com_inertia[id].coeffRef(jj, kk) = lin[jj][kk];
+	}
+      }
+      com_inertia[id] += mass[id] * lcx * lcx;
+    }
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      Eigen::Quaterniond qq(1 + 0.5 * sin(0.7 * iteration), 0.4 * cos(1.1 * iteration),
+			    -0.3 + 0.2 * iteration, 0.6 * sin(2.1 * iteration + 0.3));
+      qq.normalize();
+      for (size_t ii(0); ii < 3; ++ii) {
+	state.position_[ii] = 0.5 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      state.position_[3] = qq.x();
+      state.position_[4] = qq.y();
+      state.position_[5] = qq.z();
+      state.position_[6] = qq.w();
+      for (size_t ii(7); ii < npos; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      minitao::Vector qd(ndof);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	qd[ii] = state.velocity_[ii];
+      }
+      
+      // velocities of the link CoMs by central differences
+      double const dt(1e-6);
+      minitao::Vector twist_check(minitao::Vector::Zero(6 * points.size()));
+      std::vector<minitao::Transform> frame_minus(points.size());
+      for (int sign(-1); sign <= 1; sign += 2) {
+	minitao::State moved;
+	body_frame_move("FRPR", state, sign * dt, moved);
+	model->update(moved);
+	for (size_t ip(0); ip < points.size(); ++ip) {
+	  minitao::Transform frame;
+	  ASSERT_TRUE (model->computeGlobalFrame(points[ip].node, points[ip].local_point, frame));
+	  if (sign < 0) {
+	    frame_minus[ip] = frame;
+	    continue;
+	  }
+	  twist_check.segment(6 * ip, 3) = (frame.translation() - frame_minus[ip].translation()) / (2 * dt);
+	  Eigen::AngleAxisd const delta(frame.linear() * frame_minus[ip].linear().transpose());
+	  twist_check.segment(6 * ip + 3, 3) = delta.angle() * delta.axis() / (2 * dt);
+	}
+      }
+      model->update(state);
+      
+      std::ostringstream msg;
+      msg << "Checking free-flyer model for iteration " << iteration << "\n"
+	  << "  q  = " << state.position_ << "\n"
+	  << "  qd = " << state.velocity_ << "\n";
+      minitao::Matrix JJ;
+      ASSERT_TRUE (model->computeStackedJacobian(points, minitao::SparseJacobian::FULL, JJ));
+      EXPECT_TRUE (check_vector("J * qd", twist_check, minitao::Vector(JJ * qd), 1e-6, msg)) << msg.str();
+      
+      // mass-inertia matrix and gravity summed over links
+      minitao::Matrix AA_check(minitao::Matrix::Zero(ndof, ndof));
+      minitao::Vector gg_check(minitao::Vector::Zero(ndof));
+      for (size_t ip(0); ip < points.size(); ++ip) {
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(points[ip].node, points[ip].local_point, frame));
+	Eigen::Matrix3d const rot(frame.linear());
+	minitao::Matrix const Jv(JJ.block(6 * ip, 0, 3, ndof));
+	minitao::Matrix const Jw(JJ.block(6 * ip + 3, 0, 3, ndof));
+	AA_check += mass[ip] * Jv.transpose() * Jv
+	  + Jw.transpose() * rot * com_inertia[ip] * rot.transpose() * Jw;
+	gg_check += 9.81 * mass[ip] * Jv.row(2).transpose();
+      }
+      minitao::Matrix AA, AAinv;
+      ASSERT_TRUE (model->getMassInertia(AA));
+      EXPECT_TRUE (check_matrix("A", AA_check, AA, 1e-9, msg)) << msg.str();
+      ASSERT_TRUE (model->getInverseMassInertia(AAinv));
+      EXPECT_TRUE (check_matrix("A * Ainv", minitao::Matrix(minitao::Matrix::Identity(ndof, ndof)),
+				 minitao::Matrix(AA * AAinv), 1e-9, msg))
+	<< msg.str();
+      minitao::Vector gg;
+      ASSERT_TRUE (model->getGravity(gg));
+      EXPECT_TRUE (check_vector("g", gg_check, gg, 1e-9, msg)) << msg.str();
+      
+      // forward and inverse dynamics with velocity and gravity
+      minitao::Vector tau(ndof), acc, tau_check;
+      for (size_t ii(0); ii < ndof; ++ii) {
+	tau[ii] = 2.0 * sin(0.3 * iteration - 1.1 * ii);
+      }
+      ASSERT_TRUE (model->computeForwardDynamics(state, tau, acc));
+      ASSERT_TRUE (model->computeInverseDynamics(acc, tau_check));
+      EXPECT_TRUE (check_vector("tau", tau, tau_check, 1e-9, msg)) << msg.str();
+      minitao::Vector cc;
+      ASSERT_TRUE (model->getCoriolisCentrifugal(cc));
+      EXPECT_TRUE (check_vector("A * acc + b + g", tau, minitao::Vector(AA * acc + cc + gg), 1e-9, msg))
+	<< msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, spherical_joints)
+{
+  minitao::Model * model(0);
+  try {
+    model = create_spherical_model();
+    ASSERT_EQ (4, model->getNNodes());
+    ASSERT_EQ (4, model->getNJoints());
+    ASSERT_EQ (13, model->getNDOF());
+    ASSERT_EQ (16, model->getNPositions());
+    char const * joint_types("FSSR");	// base, shoulder, hip, knee
+    size_t const ndof(model->getNDOF());
+    size_t const npos(model->getNPositions());
+    size_t const quaternion_offset[] = { 3, 7, 11 };
+    minitao::Matrix const eye(minitao::Matrix::Identity(ndof, ndof));
+    minitao::State state(npos, ndof, 0);
+    minitao::Vector qd(ndof), acceleration(ndof);
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < npos; ++ii) {
+	state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      for (size_t iq(0); iq < 3; ++iq) {
+	double * qq(&state.position_[quaternion_offset[iq]]);
+	double const norm(sqrt(qq[0] * qq[0] + qq[1] * qq[1] + qq[2] * qq[2] + qq[3] * qq[3]));
+	for (size_t ii(0); ii < 4; ++ii) {
+	  qq[ii] /= norm;
+	}
+      }
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	qd[ii] = state.velocity_[ii];
+	acceleration[ii] = 0.5 * sin(0.4 * iteration + 1.9 * ii);
+      }
+      std::ostringstream msg;
+      msg << "Checking spherical-joint model for iteration " << iteration << "\n"
+	  << "  q  = " << state.position_ << "\n"
+	  << "  qd = " << state.velocity_ << "\n";
+      
+      // global-frame kernels against the TAO sweeps
+      model->update(state);
+      minitao::Matrix AA, AAinv, product;
+      ASSERT_TRUE (model->getMassInertia(AA));
+      ASSERT_TRUE (model->getInverseMassInertia(AAinv));
+      ASSERT_TRUE (model->computeMassInertiaProduct(eye, product));
+      EXPECT_TRUE (check_matrix("A * I", AA, product, 1e-9, msg)) << msg.str();
+      ASSERT_TRUE (model->computeInverseMassInertiaProduct(eye, product));
+      EXPECT_TRUE (check_matrix("Ainv * I", AAinv, product, 1e-9, msg)) << msg.str();
+      minitao::Vector gg, gg_check;
+      ASSERT_TRUE (model->getGravity(gg));
+      {
+	minitao::State rest(state);
+	rest.velocity_.assign(ndof, 0);
+	model->update(rest);
+	ASSERT_TRUE (model->computeInverseDynamics(minitao::Vector::Zero(ndof), gg_check));
+	model->update(state);
+      }
+      EXPECT_TRUE (check_vector("g", gg_check, gg, 1e-9, msg)) << msg.str();
+      
+      // Coriolis matrix, with the time derivative of A along the
+      // velocity in node coordinates
+      double const dt(1e-6);
+      minitao::Matrix AAdot(minitao::Matrix::Zero(ndof, ndof));
+      for (int sign(-1); sign <= 1; sign += 2) {
+	minitao::State moved;
+	body_frame_move(joint_types, state, sign * dt, moved);
+	model->update(moved);
+	ASSERT_TRUE (model->getMassInertia(AA));
+	AAdot += sign * AA / (2 * dt);
+      }
+      model->update(state);
+      model->computeCoriolisMatrix();
+      minitao::Matrix CC;
+      ASSERT_TRUE (model->getCoriolisMatrix(CC));
+      minitao::Vector cc;
+      ASSERT_TRUE (model->getCoriolisCentrifugal(cc));
+      EXPECT_TRUE (check_vector("C * qd", cc, minitao::Vector(CC * qd), 1e-6, msg)) << msg.str();
+      minitao::Matrix const NN(AAdot - 2 * CC);
+      EXPECT_TRUE (check_matrix("skew", minitao::Matrix(- NN.transpose()), NN, 1e-5, msg)) << msg.str();
+      
+      // inverse dynamics derivatives, where position steps are taken
+      // like velocities, i.e. in node coordinates
+      double const step(1e-5);
+      minitao::Matrix dpos_check(ndof, ndof), dvel_check(ndof, ndof);
+      for (size_t jj(0); jj < ndof; ++jj) {
+	minitao::State unit(state), plus, minus;
+	unit.velocity_.assign(ndof, 0);
+	unit.velocity_[jj] = 1;
+	body_frame_move(joint_types, unit, step, plus);
+	body_frame_move(joint_types, unit, - step, minus);
+	plus.velocity_ = state.velocity_;
+	minus.velocity_ = state.velocity_;
+	dpos_check.col(jj) = (model_inverse_dynamics(model, plus, acceleration)
+			      - model_inverse_dynamics(model, minus, acceleration)) / (2 * step);
+	plus = state;
+	minus = state;
+	plus.velocity_[jj] += step;
+	minus.velocity_[jj] -= step;
+	dvel_check.col(jj) = (model_inverse_dynamics(model, plus, acceleration)
+			      - model_inverse_dynamics(model, minus, acceleration)) / (2 * step);
+      }
+      minitao::Vector const tau(model_inverse_dynamics(model, state, acceleration));
+      minitao::Matrix dpos, dvel;
+      ASSERT_TRUE (model->computeInverseDynamicsDerivatives(acceleration, dpos, dvel));
+      EXPECT_TRUE (check_matrix("dtau_dposition", dpos_check, dpos, 1e-3, msg)) << msg.str();
+      EXPECT_TRUE (check_matrix("dtau_dvelocity", dvel_check, dvel, 1e-3, msg)) << msg.str();
+      
+      // hybrid dynamics with the acceleration given for every third DOF
+      std::vector<bool> acceleration_given(ndof);
+      minitao::Vector hybrid_acc(minitao::Vector::Zero(ndof)), hybrid_tau(minitao::Vector::Zero(ndof));
+      for (size_t ii(0); ii < ndof; ++ii) {
+	acceleration_given[ii] = (0 == ii % 3);
+	if (acceleration_given[ii]) {
+	  hybrid_acc[ii] = acceleration[ii];
+	}
+	else {
+	  hybrid_tau[ii] = tau[ii];
+	}
+      }
+      ASSERT_TRUE (model->computeHybridDynamics(acceleration_given, hybrid_acc, hybrid_tau));
+      EXPECT_TRUE (check_vector("hybrid acceleration", acceleration, hybrid_acc, 1e-6, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("hybrid tau", tau, hybrid_tau, 1e-6, msg)) << msg.str();
+      
+      // centroidal momentum rate along the velocity and acceleration
+      minitao::Matrix momentum_matrix;
+      minitao::Vector momentum_bias;
+      ASSERT_TRUE (model->computeCentroidalMomentum(momentum_matrix, momentum_bias));
+      minitao::Vector momentum_rate(minitao::Vector::Zero(6));
+      for (int sign(-1); sign <= 1; sign += 2) {
+	minitao::State moved;
+	body_frame_move(joint_types, state, sign * dt, moved);
+	minitao::Vector moved_qd(qd + sign * dt * acceleration);
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  moved.velocity_[ii] = moved_qd[ii];
+	}
+	model->update(moved);
+	minitao::Matrix moved_matrix;
+	minitao::Vector moved_bias;
+	ASSERT_TRUE (model->computeCentroidalMomentum(moved_matrix, moved_bias));
+	momentum_rate += sign * moved_matrix * moved_qd / (2 * dt);
+      }
+      model->update(state);
+      EXPECT_TRUE (check_vector("momentum rate", momentum_rate,
+				minitao::Vector(momentum_matrix * acceleration + momentum_bias), 1e-5, msg))
+	<< msg.str();
+      
+      // contacts on the knee and the shoulder
+      minitao::Model::contact_list_t contacts;
+      minitao::Model::node_point_list_t points;
+      for (int id(2); id <= 3; ++id) {
+	taoDNode * node(model->findNodeByID(id));
+	ASSERT_NE ((void*) 0, node);
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, 0.1, -0.05, 0.2, frame));
+	minitao::Vector const point(frame.translation());
+	contacts.push_back(minitao::Model::Contact(node, point));
+	points.push_back(minitao::Model::NodePoint(node, minitao::Vector(Eigen::Vector3d(0.1, -0.05, 0.2))));
+      }
+      minitao::Matrix JJ, delassus;
+      ASSERT_TRUE (model->computeStackedJacobian(points, minitao::SparseJacobian::POSITION, JJ));
+      ASSERT_TRUE (model->computeDelassusMatrix(contacts, delassus));
+      EXPECT_TRUE (check_matrix("delassus", minitao::Matrix(JJ * AAinv * JJ.transpose()), delassus, 1e-6, msg))
+	<< msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, fixed_links)
+{
+  minitao::Model * model(0);
+  BranchingRepresentation * ref(0);
+  try {
+    model = create_fixed_link_model();
+    // An unfused copy of the tree provides the link frames and the
+    // original mass properties.
+    ref = create_fixed_link_brep();
+    EXPECT_EQ (3u, model->getNNodes());
+    EXPECT_EQ (3u, model->getNFusedNodes());
+    size_t const ndof(model->getNDOF());
+    ASSERT_EQ (3u, ndof);
+    EXPECT_NEAR (minitao::computeTotalMass(ref->rootNode()),
+		 minitao::computeTotalMass(model->_getKGMRoot()), 1e-12);
+    int const nlinks(6);
+    minitao::idToNodeMap_t ref_nodes;
+    minitao::mapNodesToIDs(ref_nodes, ref->rootNode());
+    
+    minitao::State state(ndof, ndof, 0);
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.9 * sin(1.1 * iteration + 0.8 * ii);
+	state.velocity_[ii] = 1.3 * cos(0.7 * iteration + 0.5 * ii);
+      }
+      model->update(state);
+      minitao::Vector qd(ndof);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	qd[ii] = state.velocity_[ii];
+      }
+      for (int id(0); id < nlinks; ++id) {
+	taoDNode * ref_node(ref_nodes[id]);
+	if (ref_node->getJointList()) {
+	  minitao::SparseJacobian jacobian;
+	  ASSERT_TRUE (model->computeSparseJacobian(model->findNodeByID(id), minitao::Vector::Zero(3),
+						    minitao::SparseJacobian::POSITION, jacobian));
+	  ref_node->getJointList()->setQ(&state.position_[jacobian.dof_.back()]);
+	}
+      }
+      taoDynamics::updateTransformation(ref->rootNode());
+      
+      std::ostringstream msg;
+      msg << "Checking fixed links for\n"
+	  << "  q  = " << state.position_ << "\n"
+	  << "  qd = " << state.velocity_ << "\n";
+      minitao::Matrix AA_check(minitao::Matrix::Zero(ndof, ndof));
+      minitao::Vector g_check(minitao::Vector::Zero(ndof));
+      for (int id(0); id < nlinks; ++id) {
+	taoDNode * node(model->findNodeByID(id));
+	ASSERT_NE ((void*) 0, node) << "no node with ID " << id;
+	taoDNode * ref_node(ref_nodes[id]);
+	
+	minitao::Transform frame;
+	ASSERT_TRUE (model->getGlobalFrame(node, frame));
+	deFrame const & ref_frame(*ref_node->frameGlobal());
+	deQuaternion const & ref_quat(ref_frame.rotation());
+	minitao::Vector ref_translation(3);
+	ref_translation << ref_frame.translation()[0], ref_frame.translation()[1], ref_frame.translation()[2];
+	minitao::Matrix const ref_rotation(Eigen::Quaternion<double>(ref_quat[3], ref_quat[0], ref_quat[1],
+								     ref_quat[2]).toRotationMatrix());
+	EXPECT_TRUE (check_vector("translation", ref_translation, minitao::Vector(frame.translation()), 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+	EXPECT_TRUE (check_matrix("rotation", ref_rotation, minitao::Matrix(frame.rotation()), 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+	
+	// Sum up the mass-inertia and gravity contributions of each
+	// link at its center of mass, using its original properties.
+	double const mass(*ref_node->mass());
+	deVector3 const & lcom(*ref_node->center());
+	deMatrix3 const & lin(*ref_node->inertia());
+	Eigen::Matrix3d local_inertia;
+	for (int jj(0); jj < 3; ++jj) {
+	  for (int kk(0); kk < 3; ++kk) {
+	    local_inertia.coeffRef(jj, kk) = lin[jj][kk];
+	  }
+	}
+	Eigen::Vector3d const local_com(lcom[0], lcom[1], lcom[2]);
+	Eigen::Matrix3d const com_inertia(local_inertia
+					  - mass * (local_com.squaredNorm() * Eigen::Matrix3d::Identity()
+						    - local_com * local_com.transpose()));
+	minitao::Transform com_frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, lcom[0], lcom[1], lcom[2], com_frame));
+	Eigen::Matrix3d const rot(com_frame.rotation());
+	minitao::SparseJacobian jacobian;
+	ASSERT_TRUE (model->computeSparseJacobian(node, com_frame.translation(),
+						  minitao::SparseJacobian::FULL, jacobian));
+	minitao::Matrix JJ(minitao::Matrix::Zero(6, ndof));
+	for (size_t icol(0); icol < jacobian.dof_.size(); ++icol) {
+	  JJ.col(jacobian.dof_[icol]) = jacobian.block_.col(icol);
+	}
+	minitao::Matrix const Jv(JJ.topRows(3));
+	minitao::Matrix const Jw(JJ.bottomRows(3));
+	AA_check += mass * Jv.transpose() * Jv + Jw.transpose() * rot * com_inertia * rot.transpose() * Jw;
+	g_check += mass * Jv.transpose() * Eigen::Vector3d(0, 0, 9.81);
+	
+	minitao::Vector twist;
+	ASSERT_TRUE (model->computeJacobianProduct(node, com_frame.translation(), qd, twist));
+	EXPECT_TRUE (check_vector("twist", minitao::Vector(JJ * qd), twist, 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+	
+	minitao::Vector wrench(6);
+	for (size_t jj(0); jj < 6; ++jj) {
+	  wrench[jj] = 1.7 * sin(0.3 * iteration + 1.3 * jj + 0.9 * id);
+	}
+	minitao::Vector tau;
+	ASSERT_TRUE (model->computeJacobianTransposeProduct(node, com_frame.translation(), wrench, tau));
+	EXPECT_TRUE (check_vector("J^T * f", minitao::Vector(JJ.transpose() * wrench), tau, 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+	
+	minitao::Vector const zero(minitao::Vector::Zero(ndof));
+	minitao::Vector tau_free, tau_wrench;
+	minitao::Model::external_wrench_list_t wrenches;
+	wrenches.push_back(minitao::Model::ExternalWrench(node, com_frame.translation(),
+							  wrench.head(3), wrench.tail(3)));
+	ASSERT_TRUE (model->computeInverseDynamics(zero, tau_free));
+	ASSERT_TRUE (model->computeInverseDynamics(zero, wrenches, tau_wrench));
+	EXPECT_TRUE (check_vector("external wrench", minitao::Vector(tau_free - tau), tau_wrench, 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+      }
+      
+      minitao::Matrix AA;
+      ASSERT_TRUE (model->getMassInertia(AA));
+      EXPECT_TRUE (check_matrix("mass_inertia", AA_check, AA, 1e-9, msg)) << msg.str();
+      minitao::Vector gravity;
+      ASSERT_TRUE (model->getGravity(gravity));
+      EXPECT_TRUE (check_vector("gravity", g_check, gravity, 1e-9, msg)) << msg.str();
+      
+      // The Coriolis-centrifugal torque comes from the CC tree, which
+      // got fused separately.
+      minitao::Vector tau_free, coriolis_centrifugal;
+      ASSERT_TRUE (model->computeInverseDynamics(minitao::Vector::Zero(ndof), tau_free));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(coriolis_centrifugal));
+      EXPECT_TRUE (check_vector("coriolis_centrifugal", minitao::Vector(tau_free - gravity),
+				coriolis_centrifugal, 1e-9, msg)) << msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  if (ref) {
+    delete ref->rootNode();
+    delete ref;
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, reduced_model)
+{
+  minitao::Model * model(0);
+  minitao::Model * reduced(0);
+  try {
+    model = create_spherical_model();
+    size_t const ndof(model->getNDOF());
+    size_t const npos(model->getNPositions());
+    size_t const quaternion_offset[] = { 3, 7, 11 };
+    minitao::State state(npos, ndof, 0);
+    for (size_t ii(0); ii < npos; ++ii) {
+      state.position_[ii] = 0.8 * sin(0.9 + 0.7 * ii);
+    }
+    for (size_t iq(0); iq < 3; ++iq) {
+      double * qq(&state.position_[quaternion_offset[iq]]);
+      double const norm(sqrt(qq[0] * qq[0] + qq[1] * qq[1] + qq[2] * qq[2] + qq[3] * qq[3]));
+      for (size_t ii(0); ii < 4; ++ii) {
+	qq[ii] /= norm;
+      }
+    }
+    
+    // Lock the floating base and the hip, which leaves the shoulder
+    // and the knee.
+    std::vector<taoDNode const *> locked;
+    locked.push_back(model->findNodeByID(0));
+    locked.push_back(model->findNodeByID(1));
+    EXPECT_EQ ((void*) 0, model->createReducedModel(locked, std::vector<double>(npos - 1)));
+    reduced = model->createReducedModel(locked, state.position_);
+    ASSERT_NE ((void*) 0, reduced);
+    EXPECT_EQ (2, reduced->getNNodes());
+    EXPECT_EQ (2, reduced->getNFusedNodes());
+    ASSERT_EQ (4, reduced->getNDOF());
+    ASSERT_EQ (5, reduced->getNPositions());
+    size_t const active_dof[] = { 6, 7, 8, 12 };
+    std::vector<size_t> const active(active_dof, active_dof + 4);
+    EXPECT_TRUE (active == reduced->getActiveDOF());
+    
+    for (size_t iteration(0); iteration < 3; ++iteration) {
+      // shoulder quaternion and knee angle
+      for (size_t ii(0); ii < 4; ++ii) {
+	state.position_[7 + ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+      }
+      state.position_[15] = 0.8 * sin(1.3 * iteration + 2.8);
+      double * qq(&state.position_[7]);
+      double const norm(sqrt(qq[0] * qq[0] + qq[1] * qq[1] + qq[2] * qq[2] + qq[3] * qq[3]));
+      for (size_t ii(0); ii < 4; ++ii) {
+	qq[ii] /= norm;
+      }
+      // locked joints do not move
+      std::fill(state.velocity_.begin(), state.velocity_.end(), 0);
+      for (size_t ii(0); ii < active.size(); ++ii) {
+	state.velocity_[active[ii]] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+      }
+      minitao::State reduced_state;
+      reduced->reduceState(state, reduced_state);
+      ASSERT_EQ (5, reduced_state.position_.size());
+      ASSERT_EQ (4, reduced_state.velocity_.size());
+      model->update(state);
+      reduced->update(reduced_state);
+      
+      std::ostringstream msg;
+      msg << "Checking reduced model for iteration " << iteration << "\n"
+	  << "  q  = " << state.position_ << "\n"
+	  << "  qd = " << state.velocity_ << "\n";
+      minitao::Matrix AA, AA_reduced;
+      ASSERT_TRUE (model->getMassInertia(AA));
+      ASSERT_TRUE (reduced->getMassInertia(AA_reduced));
+      minitao::Vector gravity, gravity_reduced, cc, cc_reduced;
+      ASSERT_TRUE (model->getGravity(gravity));
+      ASSERT_TRUE (reduced->getGravity(gravity_reduced));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(cc));
+      ASSERT_TRUE (reduced->getCoriolisCentrifugal(cc_reduced));
+      minitao::Matrix CC, CC_reduced;
+      model->computeCoriolisMatrix();
+      reduced->computeCoriolisMatrix();
+      ASSERT_TRUE (model->getCoriolisMatrix(CC));
+      ASSERT_TRUE (reduced->getCoriolisMatrix(CC_reduced));
+      minitao::Matrix AA_check(4, 4), CC_check(4, 4);
+      minitao::Vector gravity_check(4), cc_check(4);
+      for (size_t ii(0); ii < 4; ++ii) {
+	for (size_t jj(0); jj < 4; ++jj) {
+	  AA_check.coeffRef(ii, jj) = AA.coeff(active[ii], active[jj]);
+	  CC_check.coeffRef(ii, jj) = CC.coeff(active[ii], active[jj]);
+	}
+	gravity_check[ii] = gravity[active[ii]];
+	cc_check[ii] = cc[active[ii]];
+      }
+      EXPECT_TRUE (check_matrix("mass_inertia", AA_check, AA_reduced, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("gravity", gravity_check, gravity_reduced, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("coriolis_centrifugal", cc_check, cc_reduced, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_matrix("coriolis_matrix", CC_check, CC_reduced, 1e-9, msg)) << msg.str();
+      
+      for (int id(0); id < 4; ++id) {
+	taoDNode * node(model->findNodeByID(id));
+	taoDNode * reduced_node(reduced->findNodeByID(id));
+	ASSERT_NE ((void*) 0, reduced_node) << "no node with ID " << id;
+	minitao::Transform frame, reduced_frame;
+	ASSERT_TRUE (model->computeGlobalFrame(node, 0.1, -0.2, 0.3, frame));
+	ASSERT_TRUE (reduced->computeGlobalFrame(reduced_node, 0.1, -0.2, 0.3, reduced_frame));
+	EXPECT_TRUE (check_matrix("frame", minitao::Matrix(frame.matrix()),
+				  minitao::Matrix(reduced_frame.matrix()), 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+	if (id < 2) {
+	  continue;		// locked links do not move
+	}
+	minitao::Matrix JJ, JJ_reduced;
+	ASSERT_TRUE (model->computeJacobian(node, frame.translation(), JJ));
+	ASSERT_TRUE (reduced->computeJacobian(reduced_node, frame.translation(), JJ_reduced));
+	minitao::Matrix JJ_check(6, 4);
+	for (size_t ii(0); ii < 4; ++ii) {
+	  JJ_check.col(ii) = JJ.col(active[ii]);
+	}
+	if (3 == id) {
+	  JJ_check.col(3).setZero();	// the knee is not an ancestor of the shoulder
+	}
+	else {
+	  JJ_check.leftCols(3).setZero();
+	}
+	minitao::SparseJacobian sparse;
+	ASSERT_TRUE (reduced->computeSparseJacobian(reduced_node, frame.translation(),
+						    minitao::SparseJacobian::FULL, sparse));
+	JJ_reduced.setZero();
+	for (size_t icol(0); icol < sparse.dof_.size(); ++icol) {
+	  JJ_reduced.col(sparse.dof_[icol]) = sparse.block_.col(icol);
+	}
+	EXPECT_TRUE (check_matrix("jacobian", JJ_check, JJ_reduced, 1e-9, msg))
+	  << msg.str() << "  node ID " << id << "\n";
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete reduced;
+  delete model;
+}
+
+
+TEST (jspaceModel, reduced_fixed_links)
+{
+  minitao::Model * model(0);
+  minitao::Model * reduced(0);
+  try {
+    // The links 1 and 2 are fused into link 0, and link 5 into link
+    // 3. Locking the prismatic joint of link 4 fuses it into link 0
+    // as well.
+    model = create_fixed_link_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      state.position_[ii] = 0.7 * sin(0.4 + 1.1 * ii);
+    }
+    std::vector<taoDNode const *> locked;
+    locked.push_back(model->findNodeByID(4));
+    reduced = model->createReducedModel(locked, state.position_);
+    ASSERT_NE ((void*) 0, reduced);
+    EXPECT_EQ (2, reduced->getNNodes());
+    EXPECT_EQ (4, reduced->getNFusedNodes());
+    ASSERT_EQ (2, reduced->getNDOF());
+    
+    // The fused links keep their own mass properties in both trees.
+    int const fused_id[] = { 1, 2, 5 };
+    for (size_t ii(0); ii < 3; ++ii) {
+      taoDNode * node(model->findNodeByID(fused_id[ii]));
+      taoDNode * reduced_node(reduced->findNodeByID(fused_id[ii]));
+      ASSERT_NE ((void*) 0, reduced_node) << "no node with ID " << fused_id[ii];
+      EXPECT_EQ (*node->mass(), *reduced_node->mass()) << "node ID " << fused_id[ii];
+    }
+    
+    std::vector<size_t> const & active(reduced->getActiveDOF());
+    ASSERT_EQ (2, active.size());
+    for (size_t ii(0); ii < active.size(); ++ii) {
+      state.velocity_[active[ii]] = 1.2 * cos(0.3 + 0.8 * ii);
+    }
+    minitao::State reduced_state;
+    reduced->reduceState(state, reduced_state);
+    model->update(state);
+    reduced->update(reduced_state);
+    
+    // The second pass changes the mass properties of a fused link in
+    // both models.
+    minitao::Vector link_com(3);
+    link_com << 0.05, -0.02, 0.1;
+    minitao::Matrix link_inertia(3, 3);
+    link_inertia <<
+      0.01,   0.001,  0,
+      0.001,  0.02,  -0.002,
+      0,     -0.002,  0.015;
+    for (size_t pass(0); pass < 2; ++pass) {
+      if (1 == pass) {
+	ASSERT_TRUE (model->setLinkInertia(model->findNodeByID(1), 1.5, link_com, link_inertia));
+	ASSERT_TRUE (reduced->setLinkInertia(reduced->findNodeByID(1), 1.5, link_com, link_inertia));
+	model->updateDynamics();
+	reduced->updateDynamics();
+      }
+      
+      std::ostringstream msg;
+      msg << "Checking reduced model with fused links in pass " << pass << " for\n"
+	  << "  q  = " << state.position_ << "\n"
+	  << "  qd = " << state.velocity_ << "\n";
+      minitao::Matrix AA, AA_reduced;
+      ASSERT_TRUE (model->getMassInertia(AA));
+      ASSERT_TRUE (reduced->getMassInertia(AA_reduced));
+      minitao::Vector gravity, gravity_reduced, cc, cc_reduced;
+      ASSERT_TRUE (model->getGravity(gravity));
+      ASSERT_TRUE (reduced->getGravity(gravity_reduced));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(cc));
+      ASSERT_TRUE (reduced->getCoriolisCentrifugal(cc_reduced));
+      minitao::Matrix AA_check(2, 2);
+      minitao::Vector gravity_check(2), cc_check(2);
+      for (size_t ii(0); ii < 2; ++ii) {
+	for (size_t jj(0); jj < 2; ++jj) {
+	  AA_check.coeffRef(ii, jj) = AA.coeff(active[ii], active[jj]);
+	}
+	gravity_check[ii] = gravity[active[ii]];
+	cc_check[ii] = cc[active[ii]];
+      }
+      EXPECT_TRUE (check_matrix("mass_inertia", AA_check, AA_reduced, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("gravity", gravity_check, gravity_reduced, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("coriolis_centrifugal", cc_check, cc_reduced, 1e-9, msg)) << msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete reduced;
+  delete model;
+}
+
+
+TEST (jspaceModel, link_inertia)
+{
+  minitao::Model * model(0);
+  minitao::Model * check_model(0);
+  try {
+    // new properties for the tool, which is merged into the elbow,
+    // and for the elbow itself
+    int const link_id[] = { 5, 3 };
+    double const link_mass[] = { 1.5, 0.7 };
+    minitao::Vector link_com[2];
+    minitao::Matrix link_inertia[2];
+    link_com[0] = minitao::Vector(3);
+    link_com[0] << 0.05, -0.02, 0.1;
+    link_inertia[0] = minitao::Matrix(3, 3);
+    link_inertia[0] <<
+      0.01,   0.001,  0,
+      0.001,  0.02,  -0.002,
+      0,     -0.002,  0.015;
+    link_com[1] = minitao::Vector(3);
+    link_com[1] << 0.15, 0.01, -0.03;
+    link_inertia[1] = minitao::Matrix(3, 3);
+    link_inertia[1] <<
+      0.03,   0,      0.004,
+      0,      0.012,  0,
+      0.004,  0,      0.035;
+    
+    // Reference: the same properties set before the model gets built.
+    BranchingRepresentation * breps[] = { create_fixed_link_brep(), create_fixed_link_brep() };
+    for (size_t ib(0); ib < 2; ++ib) {
+      minitao::idToNodeMap_t nodes;
+      minitao::mapNodesToIDs(nodes, breps[ib]->rootNode());
+      for (size_t il(0); il < 2; ++il) {
+	taoDNode * node(nodes[link_id[il]]);
+	deFrame com_frame;
+	com_frame.identity();
+	com_frame.translation().set(link_com[il][0], link_com[il][1], link_com[il][2]);
+	deMatrix3 com_inertia;
+	com_inertia.set(link_inertia[il](0, 0), link_inertia[il](0, 1), link_inertia[il](0, 2),
+			link_inertia[il](1, 0), link_inertia[il](1, 1), link_inertia[il](1, 2),
+			link_inertia[il](2, 0), link_inertia[il](2, 1), link_inertia[il](2, 2));
+	deMassProp prop;
+	prop.inertia(&com_inertia, &com_frame);
+	prop.mass(link_mass[il], &com_frame);
+	prop.get(node->mass(), node->center(), node->inertia());
+      }
+      taoDynamics::initialize(breps[ib]->rootNode());
+    }
+    check_model = new minitao::Model(breps[0]->rootNode(), breps[1]->rootNode());
+    delete breps[0];
+    delete breps[1];
+    
+    model = create_fixed_link_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, 0);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      state.position_[ii] = 0.7 * sin(0.4 + 1.1 * ii);
+      state.velocity_[ii] = 1.2 * cos(0.3 + 0.8 * ii);
+    }
+    model->update(state);
+    check_model->update(state);
+    
+    minitao::Matrix AA, AA_check;
+    EXPECT_FALSE (model->setLinkInertia(0, 1, link_com[0], link_inertia[0]));
+    EXPECT_FALSE (model->setLinkInertia(model->findNodeByID(5), -1, link_com[0], link_inertia[0]));
+    EXPECT_FALSE (model->setLinkInertia(model->findNodeByID(5), 1, minitao::Vector::Zero(2), link_inertia[0]));
+    EXPECT_FALSE (model->setLinkInertia(model->findNodeByID(5), 1, link_com[0], minitao::Matrix::Zero(3, 2)));
+    ASSERT_TRUE (model->getMassInertia(AA));
+    for (size_t il(0); il < 2; ++il) {
+      ASSERT_TRUE (model->setLinkInertia(model->findNodeByID(link_id[il]),
+					 link_mass[il], link_com[il], link_inertia[il]));
+    }
+    EXPECT_FALSE (model->getMassInertia(AA));
+    model->updateDynamics();
+    
+    std::ostringstream msg;
+    msg << "Checking link inertia update for\n"
+	<< "  q  = " << state.position_ << "\n"
+	<< "  qd = " << state.velocity_ << "\n";
+    ASSERT_TRUE (model->getMassInertia(AA));
+    ASSERT_TRUE (check_model->getMassInertia(AA_check));
+    EXPECT_TRUE (check_matrix("mass_inertia", AA_check, AA, 1e-9, msg)) << msg.str();
+    ASSERT_TRUE (model->getInverseMassInertia(AA));
+    ASSERT_TRUE (check_model->getInverseMassInertia(AA_check));
+    EXPECT_TRUE (check_matrix("inverse_mass_inertia", AA_check, AA, 1e-9, msg)) << msg.str();
+    minitao::Vector vv, vv_check;
+    ASSERT_TRUE (model->getGravity(vv));
+    ASSERT_TRUE (check_model->getGravity(vv_check));
+    EXPECT_TRUE (check_vector("gravity", vv_check, vv, 1e-9, msg)) << msg.str();
+    ASSERT_TRUE (model->getCoriolisCentrifugal(vv));
+    ASSERT_TRUE (check_model->getCoriolisCentrifugal(vv_check));
+    EXPECT_TRUE (check_vector("coriolis_centrifugal", vv_check, vv, 1e-9, msg)) << msg.str();
+    model->computeCoriolisMatrix();
+    check_model->computeCoriolisMatrix();
+    ASSERT_TRUE (model->getCoriolisMatrix(AA));
+    ASSERT_TRUE (check_model->getCoriolisMatrix(AA_check));
+    EXPECT_TRUE (check_matrix("coriolis_matrix", AA_check, AA, 1e-9, msg)) << msg.str();
+    ASSERT_TRUE (model->computeCenterOfMass(vv));
+    ASSERT_TRUE (check_model->computeCenterOfMass(vv_check));
+    EXPECT_TRUE (check_vector("com", vv_check, vv, 1e-9, msg)) << msg.str();
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete check_model;
+  delete model;
+}
+
+
+TEST (jspaceModel, regressor)
+{
+  typedef minitao::Model * (*create_model_t)();
+  create_model_t create_model[] = {
+    create_puma_model,
+    create_branching_model,
+    create_spherical_model,
+    create_fixed_link_model
+  };
+  size_t const nmodels(sizeof(create_model) / sizeof(*create_model));
+  for (size_t im(0); im < nmodels; ++im) {
+    minitao::Model * model(0);
+    try {
+      model = create_model[im]();
+      size_t const ndof(model->getNDOF());
+      size_t const npos(model->getNPositions());
+      minitao::State state(npos, ndof, 0);
+      minitao::Vector acceleration(ndof), tau, parameters;
+      minitao::Matrix YY;
+      model->getInertialParameters(parameters);
+      ASSERT_EQ (10 * model->getNNodes(), static_cast<size_t>(parameters.size()));
+      for (size_t ii(0); ii < model->getNNodes(); ++ii) {
+	ASSERT_TRUE (model->getNode(ii));
+	EXPECT_EQ (*model->getNode(ii)->mass(), parameters[10 * ii]);
+      }
+      EXPECT_FALSE (model->getNode(model->getNNodes()));
+      
+      for (size_t iteration(0); iteration < 3; ++iteration) {
+	for (size_t ii(0); ii < npos; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii + 0.2 * im);
+	}
+	// normalize the quaternions of the spherical model
+	if (16 == npos) {
+	  size_t const quaternion_offset[] = { 3, 7, 11 };
+	  for (size_t iq(0); iq < 3; ++iq) {
+	    double * qq(&state.position_[quaternion_offset[iq]]);
+	    double const norm(sqrt(qq[0] * qq[0] + qq[1] * qq[1] + qq[2] * qq[2] + qq[3] * qq[3]));
+	    for (size_t ii(0); ii < 4; ++ii) {
+	      qq[ii] /= norm;
+	    }
+	  }
+	}
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.velocity_[ii] = 1.1 * cos(0.9 * iteration + 0.4 * ii);
+	  acceleration[ii] = 0.5 * sin(0.4 * iteration + 1.9 * ii);
+	}
+	model->setState(state);
+	model->updateKinematics();
+	
+	std::ostringstream msg;
+	msg << "Checking regressor of model " << im << " for iteration " << iteration << "\n"
+	    << "  q  = " << state.position_ << "\n"
+	    << "  qd = " << state.velocity_ << "\n";
+	ASSERT_TRUE (model->computeRegressor(acceleration, YY));
+	ASSERT_EQ (ndof, static_cast<size_t>(YY.rows()));
+	ASSERT_EQ (parameters.size(), YY.cols());
+	ASSERT_TRUE (model->computeInverseDynamics(acceleration, tau));
+	minitao::Vector const tau_regressor(YY * parameters);
+	EXPECT_TRUE (check_vector("tau", tau, tau_regressor, 1e-9, msg)) << msg.str();
+      }
+      EXPECT_FALSE (model->computeRegressor(minitao::Vector::Zero(ndof + 1), YY));
+    }
+    catch (std::exception const & ee) {
+      ADD_FAILURE () << "exception with model " << im << ": " << ee.what();
+    }
+    delete model;
+  }
+  
+  // Changing the parameters only changes the parameter vector, and
+  // the identification recovers the torques from logged states.
+  minitao::Model * model(0);
+  try {
+    model = create_fixed_link_model();
+    size_t const ndof(model->getNDOF());
+    minitao::State state(ndof, ndof, ndof);
+    minitao::Vector acceleration(ndof), tau, parameters;
+    minitao::Matrix YY;
+    for (size_t ii(0); ii < ndof; ++ii) {
+      state.position_[ii] = 0.7 * sin(0.4 + 1.1 * ii);
+      state.velocity_[ii] = 1.2 * cos(0.3 + 0.8 * ii);
+      acceleration[ii] = 0.6 * cos(1.7 * ii);
+    }
+    model->setState(state);
+    model->updateKinematics();
+    ASSERT_TRUE (model->computeRegressor(acceleration, YY));
+    
+    minitao::Vector com(3);
+    com << 0.05, -0.02, 0.1;
+    minitao::Matrix inertia(3, 3);
+    inertia <<
+      0.01,   0.001,  0,
+      0.001,  0.02,  -0.002,
+      0,     -0.002,  0.015;
+    ASSERT_TRUE (model->setLinkInertia(model->findNodeByID(5), 1.5, com, inertia));
+    model->getInertialParameters(parameters);
+    ASSERT_TRUE (model->computeInverseDynamics(acceleration, tau));
+    std::ostringstream msg;
+    msg << "Checking regressor after setLinkInertia()\n";
+    minitao::Vector const tau_regressor(YY * parameters);
+    EXPECT_TRUE (check_vector("tau", tau, tau_regressor, 1e-9, msg)) << msg.str();
+    
+    minitao::ParameterEstimator estimator(model);
+    minitao::Vector estimate;
+    minitao::Vector const prior(parameters + minitao::Vector::Constant(parameters.size(), 0.1));
+    EXPECT_FALSE (estimator.solve(prior, 0, estimate));
+    EXPECT_FALSE (estimator.solve(minitao::Vector::Zero(3), 1e-6, estimate));
+    EXPECT_FALSE (estimator.addSample(minitao::State(ndof, ndof, 0), acceleration));
+    for (size_t isample(0); isample < 40; ++isample) {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 1.3 * sin(0.7 * isample + 1.1 * ii);
+	state.velocity_[ii] = 1.5 * cos(0.5 * isample + 0.8 * ii);
+	acceleration[ii] = 2.0 * sin(0.9 * isample + 2.3 * ii);
+      }
+      model->setState(state);
+      model->updateKinematics();
+      ASSERT_TRUE (model->computeInverseDynamics(acceleration, tau));
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.force_[ii] = tau[ii];
+      }
+      ASSERT_TRUE (estimator.addSample(state, acceleration));
+    }
+    EXPECT_EQ (40, estimator.getNSamples());
+    ASSERT_TRUE (estimator.solve(prior, 1e-9, estimate));
+    
+    // Not all parameters are identifiable, but the torques are.
+    for (size_t ii(0); ii < ndof; ++ii) {
+      state.position_[ii] = 0.9 * cos(0.2 + 1.4 * ii);
+      state.velocity_[ii] = 0.8 * sin(0.6 + 0.5 * ii);
+      acceleration[ii] = 1.1 * cos(0.8 * ii);
+    }
+    model->setState(state);
+    model->updateKinematics();
+    ASSERT_TRUE (model->computeRegressor(acceleration, YY));
+    ASSERT_TRUE (model->computeInverseDynamics(acceleration, tau));
+    msg << "Checking identified parameters\n";
+    minitao::Vector const tau_estimate(YY * estimate);
+    EXPECT_TRUE (check_vector("tau", tau, tau_estimate, 1e-6, msg)) << msg.str();
+    
+    estimator.reset();
+    EXPECT_EQ (0, estimator.getNSamples());
+    EXPECT_FALSE (estimator.solve(prior, 0, estimate));
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, ensemble_dynamics)
+{
+  typedef minitao::Model * (*create_model_t)();
+  create_model_t create_model[] = {
+    create_puma_model,
+    create_branching_model,
+    create_fixed_link_model
+  };
+  size_t const nmodels(sizeof(create_model) / sizeof(*create_model));
+  size_t const nmembers(3);
+  for (size_t im(0); im < nmodels; ++im) {
+    minitao::Model * model(0);
+    minitao::Model * members[nmembers] = { 0, 0, 0 };
+    try {
+      model = create_model[im]();
+      size_t const ndof(model->getNDOF());
+      size_t const nnodes(model->getNNodes());
+      minitao::State state(ndof, ndof, 0);
+      for (size_t ii(0); ii < ndof; ++ii) {
+	state.position_[ii] = 0.7 * sin(0.4 + 1.1 * ii + 0.3 * im);
+	state.velocity_[ii] = 1.2 * cos(0.3 + 0.8 * ii);
+      }
+      model->update(state);
+      
+      // Member 0 has the original parameters, the others get
+      // perturbed links.
+      minitao::Matrix parameters(10 * nnodes, nmembers);
+      for (size_t ik(0); ik < nmembers; ++ik) {
+	members[ik] = create_model[im]();
+	for (size_t ii(0); (ik > 0) && (ii < nnodes); ++ii) {
+	  minitao::Vector com(3);
+	  com << 0.1 * ik, -0.05 * ii, 0.02 * (ik + ii);
+	  minitao::Matrix inertia(3, 3);
+	  inertia <<
+	    0.2 + 0.1 * ik,  0.01,            0,
+	    0.01,            0.3 + 0.05 * ii, 0.02 * ik,
+	    0,               0.02 * ik,       0.25;
+	  ASSERT_TRUE (members[ik]->setLinkInertia(members[ik]->getNode(ii), 1 + 0.5 * ik + 0.2 * ii,
+						   com, inertia));
+	}
+	members[ik]->update(state);
+	minitao::Vector pp;
+	members[ik]->getInertialParameters(pp);
+	parameters.col(ik) = pp;
+      }
+      
+      minitao::Matrix gravity, coriolis_centrifugal;
+      std::vector<minitao::Matrix> mass_inertia;
+      ASSERT_TRUE (model->computeEnsembleDynamics(parameters, gravity, coriolis_centrifugal, mass_inertia));
+      ASSERT_EQ (nmembers, mass_inertia.size());
+      ASSERT_EQ (nmembers, static_cast<size_t>(gravity.cols()));
+      ASSERT_EQ (nmembers, static_cast<size_t>(coriolis_centrifugal.cols()));
+      for (size_t ik(0); ik < nmembers; ++ik) {
+	std::ostringstream msg;
+	msg << "Checking ensemble member " << ik << " of model " << im << "\n"
+	    << "  q  = " << state.position_ << "\n"
+	    << "  qd = " << state.velocity_ << "\n";
+	minitao::Vector vv, vv_ensemble;
+	minitao::Matrix AA;
+	ASSERT_TRUE (members[ik]->getGravity(vv));
+	vv_ensemble = gravity.col(ik);
+	EXPECT_TRUE (check_vector("gravity", vv, vv_ensemble, 1e-9, msg)) << msg.str();
+	ASSERT_TRUE (members[ik]->getCoriolisCentrifugal(vv));
+	vv_ensemble = coriolis_centrifugal.col(ik);
+	EXPECT_TRUE (check_vector("coriolis_centrifugal", vv, vv_ensemble, 1e-9, msg)) << msg.str();
+	ASSERT_TRUE (members[ik]->getMassInertia(AA));
+	EXPECT_TRUE (check_matrix("mass_inertia", AA, mass_inertia[ik], 1e-9, msg)) << msg.str();
+      }
+      
+      EXPECT_FALSE (model->disableGravityCompensation(0, true));
+      ASSERT_TRUE (model->computeEnsembleDynamics(parameters, gravity, coriolis_centrifugal, mass_inertia));
+      EXPECT_EQ (0, gravity.row(0).norm());
+      EXPECT_FALSE (model->computeEnsembleDynamics(parameters.topRows(10), gravity,
+						   coriolis_centrifugal, mass_inertia));
+    }
+    catch (std::exception const & ee) {
+      ADD_FAILURE () << "exception with model " << im << ": " << ee.what();
+    }
+    for (size_t ik(0); ik < nmembers; ++ik) {
+      delete members[ik];
+    }
+    delete model;
+  }
+}
+
+
+TEST (jspaceModel, jacobian_derivatives)
+{
+  typedef minitao::Model * (*create_model_t)();
+  create_model_t create_model[] = {
+    create_puma_model,
+    create_spherical_model,
+    create_fixed_link_model
+  };
+  // only free and spherical joints need to be told apart
+  char const * joint_types[] = { "RRRRRR", "FSSR", "RRR" };
+  size_t const nmodels(sizeof(create_model) / sizeof(*create_model));
+  double const dt(1e-5);
+  for (size_t im(0); im < nmodels; ++im) {
+    minitao::Model * model(0);
+    try {
+      model = create_model[im]();
+      size_t const ndof(model->getNDOF());
+      size_t const npos(model->getNPositions());
+      minitao::State state(npos, ndof, 0);
+      for (size_t ii(0); ii < npos; ++ii) {
+	state.position_[ii] = 0.8 * sin(0.9 + 0.7 * ii + 0.3 * im);
+      }
+      if (16 == npos) {
+	size_t const quaternion_offset[] = { 3, 7, 11 };
+	for (size_t iq(0); iq < 3; ++iq) {
+	  double * qq(&state.position_[quaternion_offset[iq]]);
+	  double const norm(sqrt(qq[0] * qq[0] + qq[1] * qq[1] + qq[2] * qq[2] + qq[3] * qq[3]));
+	  for (size_t ii(0); ii < 4; ++ii) {
+	    qq[ii] /= norm;
+	  }
+	}
+      }
+      model->setState(state);
+      model->updateKinematics();
+      
+      // the last node, and the one in the middle of the list
+      size_t const nnodes(model->getNNodes());
+      taoDNode const * const nodes[] = { model->getNode(nnodes - 1), model->getNode(nnodes / 2) };
+      minitao::Vector const local_point(Eigen::Vector3d(0.1, -0.2, 0.15));
+      for (size_t in(0); in < 2; ++in) {
+	minitao::Transform frame;
+	ASSERT_TRUE (model->computeGlobalFrame(nodes[in], local_point, frame));
+	std::vector<minitao::Matrix> derivatives;
+	ASSERT_TRUE (model->computeJacobianDerivatives(nodes[in], minitao::Vector(frame.translation()),
+						       derivatives));
+	ASSERT_EQ (ndof, derivatives.size());
+	
+	// central differences of the Jacobian along each DOF
+	for (size_t ik(0); ik < ndof; ++ik) {
+	  minitao::State direction(state);
+	  for (size_t ii(0); ii < ndof; ++ii) {
+	    direction.velocity_[ii] = (ii == ik) ? 1 : 0;
+	  }
+	  minitao::Matrix fd(minitao::Matrix::Zero(6, ndof));
+	  for (int sign(-1); sign <= 1; sign += 2) {
+	    minitao::State moved;
+	    body_frame_move(joint_types[im], direction, sign * dt, moved);
+	    model->setState(moved);
+	    model->updateKinematics();
+	    minitao::Transform moved_frame;
+	    ASSERT_TRUE (model->computeGlobalFrame(nodes[in], local_point, moved_frame));
+	    // computeJacobian() also fills the columns of DOF that do
+	    // not move the node, so use the sparse one
+	    minitao::SparseJacobian sparse;
+	    ASSERT_TRUE (model->computeSparseJacobian(nodes[in], minitao::Vector(moved_frame.translation()),
+						      minitao::SparseJacobian::FULL, sparse));
+	    minitao::Matrix JJ;
+	    sparse.scatter(ndof, JJ);
+	    fd += sign * JJ / (2 * dt);
+	  }
+	  model->setState(state);
+	  model->updateKinematics();
+	  std::ostringstream msg;
+	  msg << "Checking Jacobian derivative of model " << im << " node " << in << " DOF " << ik << "\n"
+	      << "  q  = " << state.position_ << "\n";
+	  EXPECT_TRUE (check_matrix("dJ/dq", fd, derivatives[ik], 1e-6, msg)) << msg.str();
+	}
+      }
+      
+      std::vector<minitao::Matrix> derivatives;
+      EXPECT_FALSE (model->computeJacobianDerivatives(0, minitao::Vector::Zero(3), derivatives));
+      EXPECT_FALSE (model->computeJacobianDerivatives(nodes[0], minitao::Vector::Zero(2), derivatives));
+    }
+    catch (std::exception const & ee) {
+      ADD_FAILURE () << "exception with model " << im << ": " << ee.what();
+    }
+    delete model;
+  }
+}
+
+
+static minitao::CompiledModel * compile_model(minitao::Model * model, std::string const & name)
+{
+  // The temporary files do not have the usual suffixes, so tell the
+  // compiler the language. The library stays mapped after unlink().
+  std::ostringstream code;
+  minitao::generateCompiledModel(code, model->_getKGMRoot(), name);
+  std::string const source(create_tmpfile((name + ".cpp.XXXXXX").c_str(), code.str().c_str()));
+  std::string const library(create_tmpfile((name + ".so.XXXXXX").c_str(), ""));
+  std::string const command(std::string(MINITAO_CXX_COMPILER) + " -O1 -shared -fPIC -I"
+			    + MINITAO_SOURCE_DIR + " -o " + library + " -x c++ " + source);
+  minitao::CompiledModel * compiled(0);
+  try {
+    if (0 != system(command.c_str())) {
+      throw std::runtime_error("compile_model(): `" + command + "' failed");
+    }
+    compiled = minitao::loadCompiledModel(library);
+  }
+  catch (...) {
+    unlink(source.c_str());
+    unlink(library.c_str());
+    throw;
+  }
+  unlink(source.c_str());
+  unlink(library.c_str());
+  return compiled;
+}
+
+
+TEST (codegen, compare_with_model)
+{
+  typedef minitao::Model * (*create_model_t)();
+  create_model_t create_model[] = {
+    create_puma_model,
+    create_unit_mass_RP_model,
+    create_branching_model
+  };
+  char const * name[] = {
+    "generated_puma",
+    "generated_RP",
+    "generated_branching"
+  };
+  size_t const nmodels(sizeof(create_model) / sizeof(*create_model));
+  
+  for (size_t test_index(0); test_index < nmodels; ++test_index) {
+    minitao::Model * model(0);
+    minitao::CompiledModel * compiled(0);
+    try {
+      model = create_model[test_index]();
+      compiled = compile_model(model, name[test_index]);
+      size_t const ndof(model->getNDOF());
+      ASSERT_EQ (ndof, compiled->getNDOF());
+      minitao::State state(ndof, ndof, 0);
+      
+      for (size_t iteration(0); iteration < 5; ++iteration) {
+	for (size_t ii(0); ii < ndof; ++ii) {
+	  state.position_[ii] = 0.8 * sin(1.3 * iteration + 0.7 * ii);
+	  state.velocity_[ii] = 1.5 * cos(0.9 * iteration + 1.1 * ii);
+	}
+	model->update(state);
+	compiled->setState(&state.position_[0], &state.velocity_[0]);
+	
+	for (size_t ii(0); ii < compiled->getNNodes(); ++ii) {
+	  taoDNode const * node(model->findNodeByID(compiled->getNodeID(ii)));
+	  ASSERT_NE ((void*)0, node);
+	  minitao::Transform frame;
+	  ASSERT_TRUE (model->getGlobalFrame(node, frame));
+	  minitao::Matrix rotation(3, 3);
+	  minitao::Vector translation(3);
+	  compiled->getGlobalFrame(ii, rotation.data(), translation.data());
+	  {
+	    std::ostringstream msg;
+	    msg << "Checking frame of node " << ii << " for q = " << state.position_ << "\n";
+	    minitao::Matrix const rotation_check(frame.linear());
+	    minitao::Vector const translation_check(frame.translation());
+	    EXPECT_TRUE (check_matrix("rotation", rotation_check, rotation, 1e-6, msg)) << msg.str();
+	    EXPECT_TRUE (check_vector("translation", translation_check, translation, 1e-6, msg)) << msg.str();
+	  }
+	  
+	  // computeJacobian() fills in all columns, regardless of
+	  // whether they belong to ancestors of the node, whereas the
+	  // sparse one only has the ancestor columns, just like the
+	  // generated code. This matters for the branching robot.
+	  minitao::SparseJacobian sparse;
+	  ASSERT_TRUE (model->computeSparseJacobian(node, minitao::Vector(frame.translation()),
+						    minitao::SparseJacobian::FULL, sparse));
+	  minitao::Matrix jacobian_check;
+	  sparse.scatter(ndof, jacobian_check);
+	  minitao::Matrix jacobian(6, ndof);
+	  compiled->computeJacobian(ii, frame.translation()[0], frame.translation()[1],
+				    frame.translation()[2], jacobian.data());
+	  {
+	    std::ostringstream msg;
+	    msg << "Checking Jacobian of node " << ii << " for q = " << state.position_ << "\n";
+	    EXPECT_TRUE (check_matrix("Jacobian", jacobian_check, jacobian, 1e-6, msg)) << msg.str();
+	  }
+	}
+	
+	minitao::Vector vector_check, vector(ndof);
+	ASSERT_TRUE (model->getGravity(vector_check));
+	compiled->computeGravity(vector.data());
+	{
+	  std::ostringstream msg;
+	  msg << "Checking gravity for q = " << state.position_ << "\n";
+	  EXPECT_TRUE (check_vector("gravity", vector_check, vector, 1e-6, msg)) << msg.str();
+	}
+	ASSERT_TRUE (model->getCoriolisCentrifugal(vector_check));
+	compiled->computeCoriolisCentrifugal(vector.data());
+	{
+	  std::ostringstream msg;
+	  msg << "Checking Coriolis-centrifugal for state = " << state.position_
+	      << " " << state.velocity_ << "\n";
+	  EXPECT_TRUE (check_vector("coriolis_centrifugal", vector_check, vector, 1e-6, msg)) << msg.str();
+	}
+	
+	minitao::Matrix matrix_check, matrix(ndof, ndof);
+	ASSERT_TRUE (model->getMassInertia(matrix_check));
+	compiled->computeMassInertia(matrix.data());
+	{
+	  std::ostringstream msg;
+	  msg << "Checking mass_inertia for q = " << state.position_ << "\n";
+	  EXPECT_TRUE (check_matrix("mass_inertia", matrix_check, matrix, 1e-6, msg)) << msg.str();
+	}
+	ASSERT_TRUE (model->getInverseMassInertia(matrix_check));
+	compiled->computeInverseMassInertia(matrix.data());
+	{
+	  std::ostringstream msg;
+	  msg << "Checking inv_mass_inertia for q = " << state.position_ << "\n";
+	  EXPECT_TRUE (check_matrix("inv_mass_inertia", matrix_check, matrix, 1e-6, msg)) << msg.str();
+	}
+      }
+    }
+    catch (std::exception const & ee) {
+      ADD_FAILURE () << "exception " << ee.what();
+    }
+    delete compiled;
+    delete model;
+  }
+}
 
 
 int main(int argc, char ** argv)
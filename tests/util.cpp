@@ -31,6 +31,7 @@
 #include <unistd.h>
 
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
@@ -43,10 +44,16 @@ namespace minitao {
 	throw runtime_error("create_tmpfile(): fname_template is too long (max 63 characters)");
       }
       
-      static char tmpname[64];
-      memset(tmpname, '\0', 64);
-      strncpy(tmpname, fname_template, 63);
-      int const tmpfd(mkstemp(tmpname));
+      // Keep the files out of the working directory, which might be
+      // the source tree.
+      char const * tmpdir(getenv("TMPDIR"));
+      if (( ! tmpdir) || ('\0' == tmpdir[0])) {
+	tmpdir = "/tmp";
+      }
+      string const path(string(tmpdir) + "/" + fname_template);
+      vector<char> tmpname(path.begin(), path.end());
+      tmpname.push_back('\0');
+      int const tmpfd(mkstemp(&tmpname[0]));
       if (-1 == tmpfd) {
 	throw runtime_error("create_tmpfile(): mkstemp(): " + string(strerror(errno)));
       }
@@ -57,7 +64,7 @@ namespace minitao {
       }
       close(tmpfd);
       
-      string result(tmpname);
+      string result(&tmpname[0]);
       return result;
     }
     
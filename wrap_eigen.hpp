@@ -27,6 +27,7 @@
 #define MINITAO_WRAP_EIGEN_HPP
 
 #include <Eigen/Geometry>
+#include <Eigen/SparseCore>
 
 namespace minitao {
   typedef Eigen::Affine3d Transform;
@@ -34,6 +35,8 @@ namespace minitao {
   typedef Eigen::Quaternion<double> Quaternion;
   typedef Eigen::VectorXd Vector;
   typedef Eigen::MatrixXd Matrix;
+  typedef Eigen::SparseMatrix<double, Eigen::ColMajor> SparseMatrix; // CSC
+  typedef Eigen::SparseMatrix<double, Eigen::RowMajor> SparseRowMatrix; // CSR
 }
 
 #endif // MINITAO_WRAP_EIGEN_HPP